@@ -4,6 +4,8 @@
 
 #include "Tickable.h"
 #include "AISystem.h"
+#include "FGSpawnerGrid.h"
+#include "FGAggroBatch.h"
 #include "FGAISystem.generated.h"
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam( FAggroTargetAddedSignature, TScriptInterface<class IFGAggroTargetInterface>, aggroTarget );
@@ -145,6 +147,37 @@ protected:
 	void UpdatePotentialSpawners( class AFGCreatureSpawner* inSpawner, bool withinSpawnRange, float closeSqDistance );
 
 	void ManagePotentialSpawners();
+
+	/** Rebuild mSpawnerGrid from mAllCreatureSpawners, cell size is the largest activation distance of any spawner. */
+	void RebuildSpawnerGrid();
+
+	/**
+	 * Add the spawners around the players that moved to a new grid cell to mSpawnersToEvaluate, both the spawners around the old and the new cell.
+	 * Spawners around players that stayed in their cell are still evaluated round robin by TickSpawners, but only the ones in the players' neighbourhood.
+	 * Players that have left are removed from mPlayerSpawnerCells here, the spawners around their last cell are evaluated one last time.
+	 */
+	void GatherSpawnersNearPlayers();
+
+	/** Enemy controllers register to have their aggro entries evaluated in the batched aggro update instead of on their own. */
+	void RegisterEnemyController( class AFGEnemyController* controller );
+	void UnregisterEnemyController( class AFGEnemyController* controller );
+
+	/**
+	 * Gather the aggro entries of all registered enemies into mAggroBatch, evaluate them in one pass and write the results back to the controllers.
+	 * Run every mAggroBatchInterval seconds.
+	 */
+	void UpdateAggroBatch();
+
+	/** Invalidate the cached spawn points of the spawners close to a new buildable, it may block some of the checked locations. */
+	UFUNCTION()
+	void OnBuildableConstructed( class AFGBuildable* buildable );
+
+	/** Invalidate the cached spawn points of the spawners close to a removed buildable, locations it blocked may be free now. */
+	UFUNCTION()
+	void OnBuildableRemoved( class AFGBuildable* buildable );
+
+	/** Get the lookup table for a distance curve, built the first time the curve is used. @return index into mAggroCurveTables, INDEX_NONE if no curve. */
+	int32 GetOrBuildAggroCurveTable( const class UCurveFloat* curve );
 public:
 	/** distance for disabling an enemys AI  */
 	UPROPERTY(EditDefaultsOnly,Category="AI")
@@ -224,6 +257,46 @@ private:
 	UPROPERTY( EditDefaultsOnly, Category = "AI" )
 	float mKeepAliveDistanceToPlayer;
 
+	/** Grid of the spawner locations, indices are into mAllCreatureSpawners. */
+	FSpawnerGrid mSpawnerGrid;
+
+	/** If spawners have been added or removed since the grid was built. */
+	bool mSpawnerGridDirty;
+
+	/**
+	 * The grid cell each player was in last tick.
+	 * Weak keys as players leave without telling the AI system, entries whose player is gone are dropped when the cells are updated.
+	 */
+	TMap< TWeakObjectPtr< class AFGCharacterPlayer >, FIntPoint > mPlayerSpawnerCells;
+
+	/** Spawners in the neighbourhood of any player, unique, iterated round robin with mSpawnerIterator instead of all spawners. */
+	TArray< int32 > mSpawnersNearPlayers;
+
+	/** Spawners that must be evaluated this tick as a player moved close to or away from them. */
+	TArray< int32 > mSpawnersToEvaluate;
+
+	/** Enemies that have their aggro evaluated in UpdateAggroBatch. */
+	UPROPERTY()
+	TArray< class AFGEnemyController* > mEnemyControllers;
+
+	/** How often the batched aggro update is run, in seconds. */
+	UPROPERTY( EditDefaultsOnly, Category = "AI" )
+	float mAggroBatchInterval;
+
+	/** Time until the next batched aggro update. */
+	float mAggroBatchTimer;
+
+	/** Reused between the updates to avoid reallocating. */
+	FAggroBatch mAggroBatch;
+
+	/** Lookup tables for the aggro distance curves, the enemies share the same few curves. */
+	TArray< FCurveLookupTable > mAggroCurveTables;
+	TMap< const class UCurveFloat*, int32 > mAggroCurveTableIndices;
+
+	/** The curves of mAggroCurveTables, same order. Referenced so they outlive the tables, which evaluate them outside the key range for some extrapolations. */
+	UPROPERTY( Transient )
+	TArray< class UCurveFloat* > mAggroCurves;
+
 	/** Handle to the last async trace performed */
 	FTraceHandle mLastAsyncTraceHandle;
 };
@@ -0,0 +1,200 @@
+// Copyright 2016-2020 Coffee Stain Studios. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/VectorRegister.h"
+#include "Curves/RichCurve.h"
+
+/**
+ * Uniformly sampled copy of a float curve.
+ * Evaluated with a lerp between two samples instead of a key search.
+ * Outside the key range a constant (or no) extrapolation is clamped to the end samples, which is what the curve does.
+ * Any other extrapolation, e.g. linear or cycle, is evaluated on the source curve so the result is the same as before the table.
+ */
+struct FCurveLookupTable
+{
+	static constexpr int32 NUM_SAMPLES = 64;
+
+	/** The curve must outlive the table, AFGAISystem keeps the curves of its tables referenced. */
+	void Build( const FRichCurve& curve )
+	{
+		Curve = &curve;
+		curve.GetTimeRange( MinTime, MaxTime );
+		InvStep = ( NUM_SAMPLES - 1 ) / FMath::Max( MaxTime - MinTime, KINDA_SMALL_NUMBER );
+		ClampBefore = IsClampedExtrapolation( curve.PreInfinityExtrap );
+		ClampAfter = IsClampedExtrapolation( curve.PostInfinityExtrap );
+
+		// One extra sample so a lerp at the very end does not need a bounds check.
+		Samples.SetNumUninitialized( NUM_SAMPLES + 1 );
+		for( int32 i = 0; i < NUM_SAMPLES; ++i )
+		{
+			Samples[ i ] = curve.Eval( MinTime + i / InvStep );
+		}
+		Samples[ NUM_SAMPLES ] = Samples[ NUM_SAMPLES - 1 ];
+	}
+
+	FORCEINLINE bool IsValid() const { return Samples.Num() > 0; }
+
+	FORCEINLINE float Eval( float time ) const
+	{
+		if( ( time < MinTime && !ClampBefore ) || ( time > MaxTime && !ClampAfter ) )
+		{
+			return Curve->Eval( time );
+		}
+		const float x = FMath::Clamp( ( time - MinTime ) * InvStep, 0.f, static_cast< float >( NUM_SAMPLES - 1 ) );
+		const int32 idx = FMath::TruncToInt( x );
+		return FMath::Lerp( Samples[ idx ], Samples[ idx + 1 ], x - idx );
+	}
+
+private:
+	static FORCEINLINE bool IsClampedExtrapolation( ERichCurveExtrapolation extrapolation )
+	{
+		return extrapolation == RCCE_Constant || extrapolation == RCCE_None;
+	}
+
+private:
+	const FRichCurve* Curve = nullptr;
+	float MinTime = 0.f;
+	float MaxTime = 0.f;
+	float InvStep = 0.f;
+	bool ClampBefore = true;
+	bool ClampAfter = true;
+	TArray< float > Samples;
+};
+
+/**
+ * The aggro entries of all active enemies, flattened so distances and desirabilities are computed for all of them in one pass.
+ * Entries of the same enemy are contiguous, see FEnemyRange.
+ */
+struct FAggroBatch
+{
+	/** The entries of one enemy and the weights it combines the desirabilities with. */
+	struct FEnemyRange
+	{
+		int32 FirstEntry;
+		int32 NumEntries;
+
+		/** Index into the curve tables, INDEX_NONE if the enemy has no distance curve. */
+		int32 DistanceCurve;
+
+		/** 1 / highest aggro of the enemy's entries, 0 if no aggro. */
+		float InvAggroMax;
+
+		float BaseWeight;
+		float AggroWeight;
+		float DistanceWeight;
+	};
+
+	void Reset()
+	{
+		Enemies.Reset();
+		SourceX.Reset(); SourceY.Reset(); SourceZ.Reset();
+		TargetX.Reset(); TargetY.Reset(); TargetZ.Reset();
+		BaseDesirability.Reset();
+		Aggro.Reset();
+		Distance.Reset();
+		DistanceDesirability.Reset();
+		AggroDesirability.Reset();
+		Desirability.Reset();
+	}
+
+	FORCEINLINE int32 NumEntries() const { return TargetX.Num(); }
+
+	/** Begin adding the entries of an enemy, returns the enemy index. */
+	int32 BeginEnemy( int32 distanceCurve, float aggroMax, float baseWeight, float aggroWeight, float distanceWeight )
+	{
+		FEnemyRange& range = Enemies.AddDefaulted_GetRef();
+		range.FirstEntry = NumEntries();
+		range.NumEntries = 0;
+		range.DistanceCurve = distanceCurve;
+		range.InvAggroMax = aggroMax > SMALL_NUMBER ? 1.f / aggroMax : 0.f;
+		range.BaseWeight = baseWeight;
+		range.AggroWeight = aggroWeight;
+		range.DistanceWeight = distanceWeight;
+		return Enemies.Num() - 1;
+	}
+
+	void AddEntry( const FVector& source, const FVector& target, float baseDesirability, float aggro )
+	{
+		SourceX.Add( source.X ); SourceY.Add( source.Y ); SourceZ.Add( source.Z );
+		TargetX.Add( target.X ); TargetY.Add( target.Y ); TargetZ.Add( target.Z );
+		BaseDesirability.Add( baseDesirability );
+		Aggro.Add( aggro );
+		++Enemies.Last().NumEntries;
+	}
+
+	/**
+	 * Compute the distance, the aggro, distance and combined desirabilities for all entries.
+	 * desirability = base * baseWeight + aggro / aggroMax * aggroWeight + distanceCurve( distance ) * distanceWeight
+	 */
+	void Evaluate( const TArray< FCurveLookupTable >& curveTables )
+	{
+		const int32 num = NumEntries();
+		Distance.SetNumUninitialized( num );
+		DistanceDesirability.SetNumUninitialized( num );
+		AggroDesirability.SetNumUninitialized( num );
+		Desirability.SetNumUninitialized( num );
+
+		// Squared distances for all entries, vectorized.
+		const int32 numVectorized = num & ~3;
+		for( int32 i = 0; i < numVectorized; i += 4 )
+		{
+			const VectorRegister dx = VectorSubtract( VectorLoad( TargetX.GetData() + i ), VectorLoad( SourceX.GetData() + i ) );
+			const VectorRegister dy = VectorSubtract( VectorLoad( TargetY.GetData() + i ), VectorLoad( SourceY.GetData() + i ) );
+			const VectorRegister dz = VectorSubtract( VectorLoad( TargetZ.GetData() + i ), VectorLoad( SourceZ.GetData() + i ) );
+			VectorStore( VectorMultiplyAdd( dz, dz, VectorMultiplyAdd( dy, dy, VectorMultiply( dx, dx ) ) ), Distance.GetData() + i );
+		}
+		for( int32 i = numVectorized; i < num; ++i )
+		{
+			Distance[ i ] = FMath::Square( TargetX[ i ] - SourceX[ i ] ) + FMath::Square( TargetY[ i ] - SourceY[ i ] ) + FMath::Square( TargetZ[ i ] - SourceZ[ i ] );
+		}
+
+		// The curve lookup is a gather so it is done per entry, the combine is vectorized within each enemy's range.
+		for( const FEnemyRange& enemy : Enemies )
+		{
+			const int32 end = enemy.FirstEntry + enemy.NumEntries;
+			const FCurveLookupTable* curve = curveTables.IsValidIndex( enemy.DistanceCurve ) ? &curveTables[ enemy.DistanceCurve ] : nullptr;
+			for( int32 i = enemy.FirstEntry; i < end; ++i )
+			{
+				Distance[ i ] = FMath::Sqrt( Distance[ i ] );
+				DistanceDesirability[ i ] = curve ? curve->Eval( Distance[ i ] ) : 0.f;
+			}
+
+			const VectorRegister invAggroMax = VectorSetFloat1( enemy.InvAggroMax );
+			const VectorRegister baseWeight = VectorSetFloat1( enemy.BaseWeight );
+			const VectorRegister aggroWeight = VectorSetFloat1( enemy.AggroWeight );
+			const VectorRegister distanceWeight = VectorSetFloat1( enemy.DistanceWeight );
+			int32 i = enemy.FirstEntry;
+			for( ; i + 4 <= end; i += 4 )
+			{
+				const VectorRegister aggroDesirability = VectorMultiply( VectorLoad( Aggro.GetData() + i ), invAggroMax );
+				VectorStore( aggroDesirability, AggroDesirability.GetData() + i );
+
+				VectorRegister desirability = VectorMultiply( VectorLoad( BaseDesirability.GetData() + i ), baseWeight );
+				desirability = VectorMultiplyAdd( aggroDesirability, aggroWeight, desirability );
+				desirability = VectorMultiplyAdd( VectorLoad( DistanceDesirability.GetData() + i ), distanceWeight, desirability );
+				VectorStore( desirability, Desirability.GetData() + i );
+			}
+			for( ; i < end; ++i )
+			{
+				AggroDesirability[ i ] = Aggro[ i ] * enemy.InvAggroMax;
+				Desirability[ i ] = BaseDesirability[ i ] * enemy.BaseWeight + AggroDesirability[ i ] * enemy.AggroWeight + DistanceDesirability[ i ] * enemy.DistanceWeight;
+			}
+		}
+	}
+
+	TArray< FEnemyRange > Enemies;
+
+	/** Inputs, one per entry. */
+	TArray< float > SourceX, SourceY, SourceZ;
+	TArray< float > TargetX, TargetY, TargetZ;
+	TArray< float > BaseDesirability;
+	TArray< float > Aggro;
+
+	/** Results, one per entry. */
+	TArray< float > Distance;
+	TArray< float > DistanceDesirability;
+	TArray< float > AggroDesirability;
+	TArray< float > Desirability;
+};
@@ -250,6 +250,16 @@ public:
 	*/
 	void UpdateAggroTargetsDesirabilities();
 
+	/**
+	 * Add our aggro entries to the batched aggro update in UFGAISystem.
+	 * Done instead of UpdateAggroTargetsDistance and UpdateAggroTargetsDesirabilities when registered to the AI system.
+	 * @return the enemy index in the batch, INDEX_NONE if we have nothing to add.
+	 */
+	int32 AddToAggroBatch( struct FAggroBatch& batch, int32 distanceCurveTable ) const;
+
+	/** Copy the results of the batched aggro update back to our aggro entries, then sorts them and finds the most desirable target. */
+	void ApplyAggroBatch( const struct FAggroBatch& batch, int32 enemyIndex );
+
 	/**
 	* Gets the base desirability a VALID target is for this pawn (if it hasn't attacked us at all)
 	* @param aggroTargetIndex - the target we want to check how desirable is for us
@@ -425,6 +435,9 @@ public:
 
 	/** Current attack in attack pattern */
 	int32 mAttackPatternIndex;
+
+	/** If we are registered to the batched aggro update in UFGAISystem, the update timer then only gathers and cleans up targets. */
+	bool mIsInAggroBatch;
 protected:
 	/** Called whenever a new aggro target is added */
 	UFUNCTION()
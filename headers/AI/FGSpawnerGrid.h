@@ -0,0 +1,53 @@
+// Copyright 2016-2020 Coffee Stain Studios. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Uniform 2D grid over the creature spawner locations, used to find the spawners near the players without looking at every spawner.
+ * Spawners never move so the grid is only rebuilt when spawners are added or removed.
+ * The cell size should be the largest activation distance so a player's neighbourhood is always the 3x3 cells around it.
+ */
+struct FSpawnerGrid
+{
+	/** Build the grid, index in locations is what is returned from the queries. */
+	void Build( const TArray< FVector >& locations, float cellSize )
+	{
+		Cells.Reset();
+		CellSize = FMath::Max( cellSize, 1.f );
+		for( int32 i = 0; i < locations.Num(); ++i )
+		{
+			Cells.FindOrAdd( GetCell( locations[ i ] ) ).Add( i );
+		}
+	}
+
+	FORCEINLINE bool IsEmpty() const { return Cells.Num() == 0; }
+	FORCEINLINE float GetCellSize() const { return CellSize; }
+
+	FORCEINLINE FIntPoint GetCell( const FVector& location ) const
+	{
+		return FIntPoint( FMath::FloorToInt( location.X / CellSize ), FMath::FloorToInt( location.Y / CellSize ) );
+	}
+
+	/** Add the spawners in the 3x3 cells around a cell, i.e. everything within one cell size of any point in the cell. */
+	void GetNeighbourhood( const FIntPoint& cell, TArray< int32 >& out_indices ) const
+	{
+		for( int32 y = -1; y <= 1; ++y )
+		{
+			for( int32 x = -1; x <= 1; ++x )
+			{
+				if( const TArray< int32 >* indices = Cells.Find( FIntPoint( cell.X + x, cell.Y + y ) ) )
+				{
+					out_indices.Append( *indices );
+				}
+			}
+		}
+	}
+
+private:
+	/** Spawner indices per cell, only cells with spawners are stored. */
+	TMap< FIntPoint, TArray< int32 > > Cells;
+
+	float CellSize = 1.f;
+};
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "GameFramework/Actor.h"
+#include "HAL/ThreadSafeBool.h"
 #include "FGUseableInterface.h"
 #include "ItemAmount.h"
 #include "FGDismantleInterface.h"
@@ -111,6 +112,19 @@ public:
 	/** Always ticking tick, this is where factory logic resides, other tick will be disabled pretty frequent */
 	virtual void Factory_Tick( float dt );
 
+	/** @return true if the factory tick is sleeping, it is then skipped by the buildable subsystem until woken up. */
+	FORCEINLINE bool IsFactoryTickSleeping() const { return mIsFactoryTickSleeping; }
+
+	/**
+	 * Wake up the factory tick, called on events that may let a sleeping buildable make progress again.
+	 * Safe to call from any thread and if not sleeping.
+	 */
+	FORCEINLINE void WakeUpFactoryTick()
+	{
+		mFactoryTickWakeUpCounter.Increment();
+		mIsFactoryTickSleeping = false;
+	}
+
 	/** Blueprint version of Factory_Tick */
 	UFUNCTION( BlueprintImplementableEvent, Category = "Tick", meta = ( DisplayName = "Factory_Tick" ) )
 	void Factory_ReceiveTick( float deltaTime );
@@ -309,6 +323,27 @@ protected:
 	UFUNCTION( BlueprintNativeEvent, CustomEventUsing=mHasFactory_GrabOutput, Category = "Buildable|Connections" )
 	bool Factory_GrabOutput( class UFGFactoryConnectionComponent* connection, FInventoryItem& out_item, float& out_OffsetBeyond, TSubclassOf< UFGItemDescriptor > type );
 
+	/**
+	 * Grab up to maxNum items of one class, see UFGFactoryConnectionComponent::Factory_GrabOutputBatch.
+	 * The default implementation grabs one item at a time, override where the items can be taken in one go.
+	 * @return the number of items grabbed.
+	 */
+	virtual int32 Factory_GrabOutputBatch( class UFGFactoryConnectionComponent* connection, int32 maxNum, TArray< FInventoryItem >& out_items, TArray< float >& out_offsetsBeyond, TSubclassOf< UFGItemDescriptor > type )
+	{
+		int32 numGrabbed = 0;
+		FInventoryItem item;
+		float offsetBeyond = 0.f;
+		while( numGrabbed < maxNum && Factory_GrabOutput( connection, item, offsetBeyond, type ) )
+		{
+			out_items.Add( item );
+			out_offsetsBeyond.Add( offsetBeyond );
+			// The rest of the batch must be of the same class.
+			type = item.ItemClass;
+			++numGrabbed;
+		}
+		return numGrabbed;
+	}
+
 	/**
 	* This function tells us the maximum amounts of grabs this building can make this frame
 	*
@@ -331,6 +366,26 @@ protected:
 	 */
 	virtual bool VerifyDefaults( FString& out_message );
 
+	/**
+	 * Sample the wake up counter before checking if the factory tick can sleep, pass the result to TrySleepFactoryTick.
+	 * This prevents a wake up that happens during the check from being lost.
+	 */
+	FORCEINLINE int32 GetFactoryTickWakeUpCount() const { return mFactoryTickWakeUpCounter.GetValue(); }
+
+	/**
+	 * Put the factory tick to sleep unless we've been woken up since wakeUpCount was sampled.
+	 * @return true if we're now sleeping.
+	 */
+	FORCEINLINE bool TrySleepFactoryTick( int32 wakeUpCount )
+	{
+		mIsFactoryTickSleeping = true;
+		if( mFactoryTickWakeUpCounter.GetValue() != wakeUpCount )
+		{
+			mIsFactoryTickSleeping = false;
+		}
+		return mIsFactoryTickSleeping;
+	}
+
 	/** Helper to get the cost multiplier for a buildable given its length and how long each cost segment is. */
 	static int32 GetCostMultiplierForLength( float totalLength, float costSegmentLength );
 
@@ -545,6 +600,15 @@ private:
 	/** Factory Stat id of this object, 0 if nobody asked for it yet */
 	STAT( mutable TStatId mFactoryStatID; )
 
+	/** Measured cost of this buildables factory tick, used by the subsystem to balance the parallel factory tick */
+	FFactoryTickCost mFactoryTickCost;
+
+	/** If the factory tick is sleeping, written from other threads when woken up. */
+	FThreadSafeBool mIsFactoryTickSleeping;
+
+	/** Incremented on every wake up, used to detect wake ups racing with putting the factory tick to sleep. */
+	FThreadSafeCounter mFactoryTickWakeUpCounter;
+
 	/** Squared distance to closest camera */
 	UPROPERTY( meta = (NoAutoJson = true) )
 	float mCameraDistanceSq;
@@ -5,13 +5,13 @@
 #include "FGBuildable.h"
 #include "FGRemoteCallObject.h"
 #include "FGSignificanceInterface.h"
+#include "FGConveyorItemKernels.h"
+#include "FGConveyorItemSnapshot.h"
+#include "FGConveyorDeltaEncoding.h"
+#include "Resources/FGItemRegistry.h"
 #include "FGBuildableConveyorBase.generated.h"
 
 
-using FG_ConveyorItemRepKeyType = int16;
-using FG_ConveyorVersionType = int8;
-
-
 
 UCLASS()
 class UFGConveyorRemoteCallObject : public UFGRemoteCallObject
@@ -34,7 +34,8 @@ class UFGConveyorRemoteCallObject : public UFGRemoteCallObject
 
 
 /**
-* Holds data for an item traveling on the conveyor.
+* Holds the cold data for an item traveling on the conveyor.
+* The offset and removed flag are kept in dense arrays in FConveyorBeltItems as they are all the factory tick needs to move the items.
 *
 * @note This item must not contain any object references as they will not get replicated correctly.
 * @note We do not yet support changes to variables, only initial replication will be done.
@@ -48,8 +49,7 @@ struct FConveyorBeltItem
 	GENERATED_BODY()
 public:
 	FConveyorBeltItem() :
-		Item(),
-		Offset( 0.0f )
+		Item()
 	{
 	}
 
@@ -63,15 +63,6 @@ public:
 	UPROPERTY()
 	FInventoryItem Item;
 
-	/**
-	* The offset of this item along the conveyor belt in range [0,LENGTH].
-	* @todo This only need to replicate when the item is added to the conveyor as it is simulated locally on the client after that.
-	*       Having this replicated always works for now because we never mark an item as dirty after adding it.
-	*       I.e. we only do one replication per item.
-	*/
-	UPROPERTY()
-	float Offset;
-	bool Removed = false;
 	bool AnimateRemove = false; //@TODO:[DavalliusA:Tue/11-06-2019] not really used any more? MAke sure that is the case and if so, fix it.
 
 	//Sets to a rep key value of the current version on the client when sending a pickup command. 
@@ -89,7 +80,10 @@ private:
 };
 
 
-/** Custom INetDeltaBaseState used by our custom NetDeltaSerialize. Representing a snapshot of the state, enough to calculate a delta between this state and another.*/
+/**
+ * Custom INetDeltaBaseState used by our custom NetDeltaSerialize. Representing a snapshot of the state, enough to calculate a delta between this state and another.
+ * The items are not copied, the state shares the snapshot of the belt's history for the same version, see FConveyorItemSnapshotRef.
+ */
 class FConveyorBeltItemsBaseState : public INetDeltaBaseState
 {
 public:
@@ -110,8 +104,7 @@ public:
 
 	FConveyorBeltItemsBaseState( const FConveyorBeltItemsBaseState& other )
 	{
-		TypeToBitIDMap = other.TypeToBitIDMap;
-		ItemList = other.ItemList;
+		Snapshot = other.Snapshot;
 		ArrayReplicationKey = other.ArrayReplicationKey;
 		lastSentSpacing = other.lastSentSpacing;
 		NewestItemID = other.NewestItemID;
@@ -122,8 +115,7 @@ public:
 
 	FConveyorBeltItemsBaseState( FConveyorBeltItemsBaseState&& other )
 	{
-		TypeToBitIDMap = other.TypeToBitIDMap;
-		ItemList = other.ItemList;
+		Snapshot = MoveTemp( other.Snapshot );
 		ArrayReplicationKey = other.ArrayReplicationKey;
 		lastSentSpacing = other.lastSentSpacing;
 		NewestItemID = other.NewestItemID;
@@ -136,20 +128,19 @@ public:
 
 	const FConveyorBeltItemsBaseState& operator=( const FConveyorBeltItemsBaseState& other )
 	{
-		TypeToBitIDMap = other.TypeToBitIDMap;
-		ItemList = other.ItemList;
+		Snapshot = other.Snapshot;
 		ArrayReplicationKey = other.ArrayReplicationKey;
 		lastSentSpacing = other.lastSentSpacing;
 		NewestItemID = other.NewestItemID;
 		NextToMoveOutItemID = other.NextToMoveOutItemID;
 		ArrayReplicationKeyLoopCounter = other.ArrayReplicationKeyLoopCounter;
 		PresistentClientInfoPtr = other.PresistentClientInfoPtr;
+		return *this;
 	}
 
 	const FConveyorBeltItemsBaseState& operator=( FConveyorBeltItemsBaseState&& other )
 	{
-		TypeToBitIDMap = other.TypeToBitIDMap;
-		ItemList = other.ItemList;
+		Snapshot = MoveTemp( other.Snapshot );
 		ArrayReplicationKey = other.ArrayReplicationKey;
 		lastSentSpacing = other.lastSentSpacing;
 
@@ -157,36 +148,26 @@ public:
 		NextToMoveOutItemID = other.NextToMoveOutItemID;
 		ArrayReplicationKeyLoopCounter = other.ArrayReplicationKeyLoopCounter;
 		PresistentClientInfoPtr = other.PresistentClientInfoPtr;
-
+		return *this;
 	}
 
 	virtual bool IsStateEqual( INetDeltaBaseState* otherState ) override
 	{
 		FConveyorBeltItemsBaseState* other = static_cast< FConveyorBeltItemsBaseState* >( otherState );
-		if( ItemList.Num() != other->ItemList.Num() )
-		{	
-			return false;
-		}
 		if( lastSentSpacing != other->lastSentSpacing )
 		{	
 			return false;
 		}
-		for( int32 i = 0; i < ItemList.Num(); ++i )
+		// States created for the same version share the snapshot, no need to look at the items
+		if( Snapshot.IsSameSnapshot( other->Snapshot ) )
 		{
-			if( ItemList[ i ] != other->ItemList[ i ] )
-			{
-				return false;
-			}
+			return true;
 		}
-		for( auto it = TypeToBitIDMap.CreateIterator(); it; ++it )
+		if( !Snapshot.IsValid() || !other->Snapshot.IsValid() )
 		{
-			auto ptr = other->TypeToBitIDMap.Find( it.Key() );
-			if( !ptr || *ptr != it.Value() )
-			{
-				return false;
-			}
+			return false;
 		}
-		return true;
+		return Snapshot->IsContentEqual( *other->Snapshot );
 	}
 
 
@@ -196,33 +177,12 @@ public:
 	//virtual void DebugPrintWhenACK() override;
 	//virtual FString GetDeltaIDDebugString() override;
 
-	/**Trasnaltion of class type to an int id, so we can minimize each send size. Nb elements will be used to find a sed*/
-
-	TMap< TSubclassOf< class UFGItemDescriptor >, uint8 > TypeToBitIDMap;
-	/** This maps ReplicationID to our last known replication key. */
-	//TMap< int16, int16 > ItemKeyMap;
-	struct ItemHolder
-	{
-		ItemHolder( FG_ConveyorItemRepKeyType _id, bool _removed, float _offset ) : RepID( _id ), Removed( _removed ), Offset(_offset){}
-		FG_ConveyorItemRepKeyType RepID;
-		bool Removed = false;
-		//@TODO:[DavalliusA:Tue/11-06-2019] remove this? We probably don't need this. But actually, we probably don't need this whole list. Just holding first and last IDs should be enough. Reconsider this implementation to save memory.
-		float Offset; //[DavalliusA:Tue/14-05-2019] used to store a position, so we can accurately predict what item to remove when getting a pickup event from a client.
-		//@TODO:[DavalliusA:Tue/14-05-2019] consider how to handle pickups happening on the edge of a conveyor, but it should be an no issue once we merge?
-		inline bool operator!=( const ItemHolder& B ) const
-		{
-			return B.RepID != RepID || B.Removed != Removed;
-		}
-		inline bool operator==( const ItemHolder& B ) const
-		{
-			return B.RepID == RepID && B.Removed == Removed;
-		}
-	};
+	typedef FConveyorItemHolder ItemHolder;
 
-	
+	/** Items and the translation of class type to an int id, shared with the history entry of ArrayReplicationKey. */
+	FConveyorItemSnapshotRef Snapshot;
 
-	float lastSentSpacing = -100; //used to know if we need to send a new spacing or if we can use the default state
-	TArray<ItemHolder> ItemList; //[DavalliusA:Thu/11-04-2019] see if we can move this to a static size, or templateify the size, so we can keep it in one memory chunk for each history entry.
+	float lastSentSpacing = -100; //used to know if we need to send a new spacing or if we can use the default state. Also the spacing the offsets in the next delta are predicted from, see FConveyorDeltaEncoding::SerializeOffsets.
 
 	FG_ConveyorItemRepKeyType NewestItemID = INDEX_NONE;
 	FG_ConveyorItemRepKeyType NextToMoveOutItemID = INDEX_NONE + 1; //oldest item. If the conveyor is empty, this value will be NewestItemID+1
@@ -274,7 +234,8 @@ struct FConveyorBeltItems
 	struct ItemHolderHistory //[DavalliusA:Tue/14-05-2019] used to store a history list on the server, with a looping array of version, to be be able to jump back in time for interactions sent from clients (picking up items and such)
 	{
 		FG_ConveyorVersionType ArrayReplicationKey = INDEX_NONE;
-		TArray<FConveyorBeltItemsBaseState::ItemHolder> ItemList;
+		/** Written once when the version is added, then shared with the base states sent for this version. */
+		FConveyorItemSnapshotRef Snapshot;
 	};
 
 	GENERATED_BODY()
@@ -291,9 +252,16 @@ struct FConveyorBeltItems
 		return Items.IsValidIndex( index );
 	}
 
-	FORCEINLINE void Add( const FConveyorBeltItem& item )
+	/**
+	 * Add a new item at the end of the belt, i.e. the input side.
+	 * @param offset - The offset of this item along the conveyor belt in range [0,LENGTH].
+	 */
+	FORCEINLINE void Add( const FConveyorBeltItem& item, float offset )
 	{
 		Items.Add( item );
+		ItemOffsets.Add( offset );
+		ItemClassIDs.Add( FItemRegistry::GetID( item.Item.ItemClass ) );
+		ItemRemovedFlags.Add( item.Item.IsValid() ? 0 : 1 );
 		Items.Last().ReplicationID = INDEX_NONE;
 		MarkItemDirty( Items.Last() );
 		if( Items.Num() > 1 )
@@ -329,18 +297,71 @@ struct FConveyorBeltItems
 	FORCEINLINE void RemoveItemFromListAt( int16 index )
 	{
 		Items.RemoveAt( index );
+		ItemOffsets.RemoveAt( index );
+		ItemClassIDs.RemoveAt( index );
+		ItemRemovedFlags.RemoveAt( index );
 
 		MarkArrayDirty();
 	}
 
-	FORCEINLINE bool IsRemovedAt( int16 index )
+	/** Remove all items flagged for removal in one pass, keeping the order of the rest. @return the number of items removed. */
+	int16 RemoveFlaggedItems()
 	{
-		return Items[ index ].Removed || !Items[index].Item.IsValid();
+		const int32 oldNum = Items.Num();
+		const int32 newNum = FConveyorItemKernels::CompactRemoved( ItemOffsets, ItemClassIDs, ItemRemovedFlags, Items );
+		if( newNum != oldNum )
+		{
+			MarkArrayDirty();
+		}
+		return ( int16 )( oldNum - newNum );
+	}
+
+	/** Invalid items are flagged as removed when added, so this does not need to touch the cold item data. */
+	FORCEINLINE bool IsRemovedAt( int16 index ) const
+	{
+		return ItemRemovedFlags[ index ] != 0;
 	}
 
 	FORCEINLINE void FlagForRemoveAt( int16 index )
 	{
-		Items[ index ].Removed = true;
+		ItemRemovedFlags[ index ] = 1;
+	}
+
+	/** The offset of the item along the conveyor belt in range [0,LENGTH]. */
+	FORCEINLINE float GetOffsetAt( int16 index ) const
+	{
+		return ItemOffsets[ index ];
+	}
+
+	FORCEINLINE void SetOffsetAt( int16 index, float offset )
+	{
+		ItemOffsets[ index ] = offset;
+	}
+
+	/** Offset of all items, same order as the items. */
+	FORCEINLINE const TArray< float >& GetOffsets() const
+	{
+		return ItemOffsets;
+	}
+
+	/**
+	 * Get the item class without touching the cold item data.
+	 * Falls back to the cold data for a class without an id, e.g. one that was not loaded when the FItemRegistry was built.
+	 */
+	FORCEINLINE TSubclassOf< class UFGItemDescriptor > GetItemClassAt( int16 index ) const
+	{
+		const FItemClassID id = ItemClassIDs[ index ];
+		return FItemRegistry::IsValidID( id ) ? FItemRegistry::GetItemClass( id ) : Items[ index ].Item.ItemClass;
+	}
+
+	/**
+	 * Move all items forward, closing up gaps behind blocked items.
+	 * @param moveDelta - how far an unblocked item moves.
+	 * @param headLimit - max offset for the first item, i.e. the length of the belt or less if the output is blocked.
+	 */
+	FORCEINLINE void AdvanceItems( float moveDelta, float headLimit, float spacing )
+	{
+		FConveyorItemKernels::AdvanceOffsets( ItemOffsets.GetData(), ItemOffsets.Num(), moveDelta, headLimit, spacing );
 	}
 
 	FORCEINLINE FConveyorBeltItem& operator[]( int16 index )
@@ -365,7 +386,11 @@ struct FConveyorBeltItems
 	{
 		return ArrayReplicationKeyLastSerialized;
 	}
-	/** Custom delta serialization. */
+	/**
+	 * Custom delta serialization.
+	 * Items are written with FConveyorDeltaEncoding, quantized offsets predicted from the spacing and run length encoded classes with bit ids sized to the classes on the belt.
+	 * A belt with no change since the base state writes a single bit, so the unchanged belts of a bucket cost next to nothing in the bunch.
+	 */
 	bool NetDeltaSerialize( FNetDeltaSerializeInfo& parms );
 
 	/** Mark the array dirty. */
@@ -390,13 +415,14 @@ struct FConveyorBeltItems
 	float ConsumeAndUpdateConveyorOffsetDept( float dt );
 
 	ItemHolderHistory* GetHistoryVersion( FG_ConveyorVersionType version );
+
+	/**
+	 * Get the history entry for a version, reusing the oldest entry if the version is not in the history.
+	 * A reused entry drops its snapshot, fill it with Snapshot.MakeUnique() which takes one from the pool.
+	 * Base states for the version should then copy the Snapshot handle rather than the items.
+	 */
 	ItemHolderHistory* AddAndGetHistoryVersion( FG_ConveyorVersionType version )
 	{
-		if( !VersionHistoryStateList )
-		{
-			VersionHistoryStateList = new ItemHolderHistory[ NUM_HISTORY_VERSION ];
-		}
-		
 		for( int32 i = 0; i < NUM_HISTORY_VERSION; ++i )
 		{
 			if( VersionHistoryStateList[ i ].ArrayReplicationKey == version )
@@ -409,7 +435,7 @@ struct FConveyorBeltItems
 		if( VersionHistoryStateListWriteHead >= NUM_HISTORY_VERSION )
 			VersionHistoryStateListWriteHead = 0;
 		VersionHistoryStateList[ VersionHistoryStateListWriteHead ].ArrayReplicationKey = version;
-		VersionHistoryStateList[ VersionHistoryStateListWriteHead ].ItemList.Reset();
+		VersionHistoryStateList[ VersionHistoryStateListWriteHead ].Snapshot.Reset();
 		return &( VersionHistoryStateList[ VersionHistoryStateListWriteHead ] );
 	}
 
@@ -417,6 +443,12 @@ struct FConveyorBeltItems
 	{
 		return AnimRemoveItems;
 	}
+
+	/** Offsets for the items in the anim remove list, same order. */
+	TArray< float >& AnimRemoveOffsetList()
+	{
+		return AnimRemoveOffsets;
+	}
 	bool IsDesynced()
 	{
 		return bIsDesynced;
@@ -438,11 +470,20 @@ private:
 	UPresistentConveyorPackagingData* PresistentPackDataPtr;
 	TMap< TSubclassOf< class UFGItemDescriptor >, uint8 > TypeToBitIDMap;
 
-	ItemHolderHistory* VersionHistoryStateList = nullptr;
+	/** Ring of the last versions, fixed size and part of the struct so no allocations are done per belt. */
+	ItemHolderHistory VersionHistoryStateList[ NUM_HISTORY_VERSION ];
 	int8 VersionHistoryStateListWriteHead = NUM_HISTORY_VERSION;
 
 	TArray< FConveyorBeltItem > Items; //0 = first added item (item to be removed/move out next), max/end/n = newest item/item added most recently.
+
+	/** Hot data for the items, parallel to Items. This is what the factory tick iterates. */
+	TArray< float > ItemOffsets;
+	/** FItemRegistry id of each item's class, shared by all belts so there is no per belt table to outgrow. */
+	TArray< FItemClassID > ItemClassIDs;
+	TArray< uint8 > ItemRemovedFlags;
+
 	TArray< FConveyorBeltItem > AnimRemoveItems; //holding items we should no longer include in logics, and are just removing animation wise
+	TArray< float > AnimRemoveOffsets;
 	FG_ConveyorItemRepKeyType NewestItemID = INDEX_NONE;
 
 	//@TODO:[DavalliusA:Fri/12-04-2019]  consider moving this to an object we allocate only on clients?
@@ -558,7 +599,7 @@ private:
 
 	FG_ConveyorVersionType BaseReplicationKey = INDEX_NONE;
 
-	float lastRecivedSpacing = 0; //we should not need to store this in the delta history, as a new spacing should be sent if any of them are irregular enough to need a new spacing.
+	float lastRecivedSpacing = 0; //the adaptive spacing prediction on the client, updated by FConveyorDeltaEncoding::SerializeOffsets the same way as lastSentSpacing on the server. we should not need to store this in the delta history, as a new spacing should be sent if any of them are irregular enough to need a new spacing.
 	float ConveyorOffsetDept = 0; //used to adjust for removes and adds that were received with bad timing
 	float DeltaSinceLastNetUpdate = 0; //@TODO:[DavalliusA:Tue/11-06-2019] store a time in the delta log, so we can know the time since for the individual deltas? This can get arbitary quickly...
 	float DescynNotifyTimer = -100;
@@ -645,16 +686,35 @@ public:
 
 	FORCEINLINE int32 GetConveyorBucketID() const { return mConveyorBucketID; }
 
+	/** Set the position of this conveyor within its bucket, see FConveyorBucket::PositionBase. */
+	FORCEINLINE void SetConveyorBucketPosition( int32 position ) { mConveyorBucketPosition = position; }
+
+	FORCEINLINE int32 GetConveyorBucketPosition() const { return mConveyorBucketPosition; }
+
+	/** @return true if the items on this conveyor is owned by the lane of its bucket, the items on the conveyor are then only a copy for visuals and saving. */
+	FORCEINLINE bool IsSimulatedByLane() const { return mIsSimulatedByLane; }
+
 	/** Returns how much room there currently is on the belt. If the belt is empty it will return the length of the belt */
 	float GetAvailableSpace() const;
 
 	/** Returns how much room there was on the belt after the last factory tick. If the belt is empty it will return the length of the belt */
 	float GetCachedAvailableSpace_Threadsafe() const;
 
+	/**
+	 * Get the steady state of the items on this belt, i.e. a uniform train of a single item class.
+	 * @return false if the items are not uniformly spaced or of mixed classes.
+	 */
+	bool GetSteadyState( float itemsPerSecond, struct FConveyorSteadyState& out_steadyState ) const;
+
+	/** Replace the items on the belt with the materialized steady state, used when a region leaves the analytical mode. */
+	void ApplySteadyState( const struct FConveyorSteadyState& steadyState, double elapsed );
+
 protected:
 	// Begin Factory_ interface
 	virtual bool Factory_PeekOutput_Implementation( const class UFGFactoryConnectionComponent* connection, TArray< FInventoryItem >& out_items, TSubclassOf< UFGItemDescriptor > type ) const override;
 	virtual bool Factory_GrabOutput_Implementation( class UFGFactoryConnectionComponent* connection, FInventoryItem& out_item, float& out_OffsetBeyond, TSubclassOf< UFGItemDescriptor > type ) override;
+	/** Takes all items past the end of the belt in one go, the items are flagged removed and compacted once. */
+	virtual int32 Factory_GrabOutputBatch( class UFGFactoryConnectionComponent* connection, int32 maxNum, TArray< FInventoryItem >& out_items, TArray< float >& out_offsetsBeyond, TSubclassOf< UFGItemDescriptor > type ) override;
 	// End Factory_ interface
 
 	// Begin AFGBuildable interface
@@ -674,7 +734,13 @@ protected:
 	bool Factory_HasItemAt( int32 index ) const;
 	/** Lets you know what type of item is on a specific index. */
 	const FConveyorBeltItem& Factory_PeekItemAt( int32 index ) const;
-	/** Remove an item from the belt at index. */
+	/** Lets you know where on the belt the item on a specific index is. */
+	float Factory_PeekItemOffsetAt( int32 index ) const;
+	/**
+	 * Remove an item from the belt at index.
+	 * If the belt is simulated by a lane the item is removed from the lane through AFGBuildableSubsystem::RemoveConveyorItemFromLane,
+	 * otherwise it would come back the next time the belt is materialized from the lane.
+	 */
 	void Factory_RemoveItemAt( int32 index );
 
 private:
@@ -743,4 +809,12 @@ private:
 	/** The id for the conveyor bucket this conveyor belongs to */
 	int32 mConveyorBucketID;
 
+	/** Position in the conveyor bucket, lets the subsystem find the conveyor in its bucket without searching */
+	int32 mConveyorBucketPosition;
+
+	/** If the bucket this conveyor belongs to is simulated as a lane, Factory_Tick is skipped and the items are owned by the lane. */
+	bool mIsSimulatedByLane;
+
+	friend class AFGBuildableSubsystem;
+
 };
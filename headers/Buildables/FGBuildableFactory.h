@@ -7,6 +7,7 @@
 #include "FGSignificanceInterface.h"
 #include "FGReplicationDetailInventoryComponent.h"
 #include "FGReplicationDetailActor_BuildableFactory.h"
+#include "FGFactorySteadyState.h"
 #include "FGBuildableFactory.generated.h"
 
 DECLARE_MULTICAST_DELEGATE_ThreeParams( EProductionStatusChange, class AFGBuildable*, EProductionStatus /*oldStatus*/, EProductionStatus /*newStatus*/);
@@ -156,7 +157,7 @@ public:
 	UFUNCTION( BlueprintPure, BlueprintNativeEvent, CustomEventUsing=mHasCanProduce, Category = "FactoryGame|Factory|Production" )
 	bool CanProduce() const;
 
-	/** Set if this factory should pause it's production or not. */
+	/** Set if this factory should pause it's production or not. Wakes up the factory tick, leaving standby does not change the power state so nothing else would. */
 	UFUNCTION( BlueprintCallable, Category = "FactoryGame|Factory|Production" )
 	virtual void SetIsProductionPaused( bool isPaused );
 
@@ -205,7 +206,7 @@ public:
 	UFUNCTION( BlueprintCallable, Category = "FactoryGame|Factory|Productivity" )
 	FORCEINLINE float GetPendingPotential() const { return mPendingPotential; }
 
-	/** Set a new pending potential, the current one will be changed to this when we finish a production cycle */
+	/** Set a new pending potential, the current one will be changed to this when we finish a production cycle. Wakes up the factory tick. */
 	UFUNCTION( BlueprintCallable, Category = "FactoryGame|Factory|Productivity" )
 	virtual void SetPendingPotential( float newPendingPotential );
 
@@ -335,6 +336,37 @@ protected:
 	/** Tick the fact that we are not producing. Used for productivity calculations. */
 	virtual void Factory_TickProductivity( float dt );
 
+	/**
+	 * Can this factory stop ticking until woken up by an event, i.e. it can not make any progress on its own.
+	 * True when on standby, or when not producing and unable to produce because of a full output or starved input.
+	 * Factories with pipe connections, blueprint ticks or pending timers (mMinimumStoppedTime) never sleep.
+	 * Woken up by inventory, power and connection changes, and by SetIsProductionPaused and SetPendingPotential. Overrides of those setters must call the super.
+	 * Override this if your factory can make progress without any of those changes.
+	 */
+	virtual bool Factory_CanSleep() const;
+
+	/** Put this factory to sleep if it can, called at the end of Factory_Tick. */
+	void Factory_TrySleep( int32 wakeUpCount );
+
+	/** Called from the first Factory_Tick after being woken up, catches up on productivity and timers for the time slept. */
+	virtual void Factory_OnWokenUp( float timeSlept );
+
+public:
+	/**
+	 * Get the rates this factory consumes and produces at when producing uninterrupted.
+	 * @return false if this factory can not be simulated analytically, e.g. not configured or production depends on something other than its inventories.
+	 */
+	virtual bool GetSteadyState( FFactorySteadyState& out_steadyState ) const;
+
+	/**
+	 * Apply the result of an analytical fast forward, the inventories have already been updated by the region.
+	 * @param numCycles - production cycles completed while in steady state.
+	 * @param steadyState - the state when leaving, restores the production progress.
+	 */
+	virtual void Factory_ApplyFastForward( int32 numCycles, float elapsed, const FFactorySteadyState& steadyState );
+
+protected:
+
 	/** Calls blueprint when we tick production. */
 	UFUNCTION( BlueprintImplementableEvent, CustomEventUsing = mHasFactory_TickProducing, Category = "FactoryGame|Factory|Production", meta=(DisplayName="Factory_TickProducing") )
 	void Factory_ReceiveTickProducing( float deltaTime );
@@ -365,6 +397,18 @@ private:
 	UFUNCTION()
 	void OnPotentialInventoryItemRemoved( TSubclassOf< class UFGItemDescriptor > itemClass, int32 numRemoved );
 
+	/** Bound to OnItemAddedDelegate/OnItemRemovedDelegate on our inventories, wakes up the factory tick. */
+	UFUNCTION()
+	void OnInventoryItemAdded_WakeUp( TSubclassOf< class UFGItemDescriptor > itemClass, int32 numAdded );
+	UFUNCTION()
+	void OnInventoryItemRemoved_WakeUp( TSubclassOf< class UFGItemDescriptor > itemClass, int32 numRemoved );
+
+	/** Bound to OnHasPowerChangedDelegate on our power info, wakes up the factory tick. */
+	void OnPowerInfoHasPowerChanged_WakeUp( bool hasPower );
+
+	/** Bind the wake up events to our inventories and power info, called from BeginPlay. */
+	void BindFactoryTickWakeUpEvents();
+
 	class AFGReplicationDetailActor_BuildableFactory* GetCastRepDetailsActor() const { return Cast<AFGReplicationDetailActor_BuildableFactory>( mReplicationDetailActor ); } // @todo: make this a static function instead
 
 public:
@@ -505,6 +549,9 @@ private:
 	/** Accumulator for the effect update interval */
 	float mEffectUpdateAccumulator;
 
+	/** World time when we put the factory tick to sleep, negative if not sleeping. */
+	float mFactoryTickSleepTimeStamp;
+
 	/** Cached value of Fluid Resource Stack Size ( set in begin play from the default stack enum ) */
 	int32 mCachedFluidStackSize;
 
@@ -35,6 +35,8 @@ public:
 	virtual float GetDefaultProductionCycleTime() const override;
 	virtual float GetProductionCycleTimeForRecipe( TSubclassOf< UFGRecipe > recipe ) const override;
 	virtual float CalcProductionCycleTimeForPotential( float potential ) const override;
+	virtual bool GetSteadyState( FFactorySteadyState& out_steadyState ) const override;
+	virtual void Factory_ApplyFastForward( int32 numCycles, float elapsed, const FFactorySteadyState& steadyState ) override;
 	// End AFGBuildableFactory interface
 
 	// Begin IFGReplicationDetailActorOwnerInterface
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "Buildables/FGBuildableAttachmentSplitter.h"
+#include "Resources/FGItemRegistry.h"
 #include "FGBuildableSplitterSmart.generated.h"
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE( FOnSortRulesChanged );
@@ -35,6 +36,103 @@ public:
 	int32 OutputIndex;
 };
 
+/**
+ * The sort rules of a smart splitter compiled to a bitmask of outputs per item class, indexed by the FItemRegistry id.
+ * Rebuilt when the rules change, so routing an item is an array lookup and no allocations.
+ * Wildcard outputs only take the items that have no rule of their own, like the undefined outputs.
+ */
+struct FSplitterSortRuleTable
+{
+	/** Outputs that fit in the bitmasks. */
+	static constexpr int32 MAX_OUTPUTS = 8;
+	static_assert( sizeof( uint8 ) * 8 >= MAX_OUTPUTS, "The output masks must have a bit per output." );
+
+	/** Clear all rules and size the tables for all registered item classes. */
+	void Reset()
+	{
+		RuleMasks.Init( 0, FItemRegistry::Num() );
+		LastOutputs.Init( INDEX_NONE, FItemRegistry::Num() );
+		UndefinedMask = 0;
+		UnregisteredLastOutput = INDEX_NONE;
+	}
+
+	/**
+	 * Add a rule for an item class, any undefined rules are added with a null class and only apply to items without a rule of their own.
+	 * @return false if the output does not fit in the masks or the class has no id, the rule is then ignored.
+	 */
+	bool AddRule( TSubclassOf< UFGItemDescriptor > itemClass, int32 outputIndex )
+	{
+		if( outputIndex < 0 || outputIndex >= MAX_OUTPUTS )
+		{
+			return false;
+		}
+		if( !itemClass )
+		{
+			UndefinedMask |= ( 1 << outputIndex );
+			return true;
+		}
+		const FItemClassID id = FItemRegistry::GetID( itemClass );
+		if( !RuleMasks.IsValidIndex( id ) )
+		{
+			return false;
+		}
+		RuleMasks[ id ] |= ( 1 << outputIndex );
+		return true;
+	}
+
+	/** Add a wildcard output, it takes every item that has no rule of their own. Same as an undefined rule for routing. */
+	bool AddWildcard( int32 outputIndex )
+	{
+		return AddRule( nullptr, outputIndex );
+	}
+
+	/** Get the outputs for an item class, the undefined outputs if the class has no rule of its own. */
+	FORCEINLINE uint8 GetOutputMask( FItemClassID id ) const
+	{
+		const uint8 ruleMask = RuleMasks.IsValidIndex( id ) ? RuleMasks[ id ] : 0;
+		return ruleMask != 0 ? ruleMask : UndefinedMask;
+	}
+
+	/**
+	 * Pick the next output for an item in round robin order, each item class has its own cursor.
+	 * @param id - FItemRegistry::GetID( itemClass ).
+	 * @param availableMask - Outputs that can take the item this tick.
+	 * @return the output index, INDEX_NONE if none of the outputs are available.
+	 */
+	int32 PickOutput( FItemClassID id, uint8 availableMask, int32 numOutputs )
+	{
+		numOutputs = FMath::Min( numOutputs, MAX_OUTPUTS );
+		const uint8 mask = GetOutputMask( id ) & availableMask;
+		if( mask == 0 || numOutputs <= 0 )
+		{
+			return INDEX_NONE;
+		}
+		int8& lastOutput = LastOutputs.IsValidIndex( id ) ? LastOutputs[ id ] : UnregisteredLastOutput;
+		for( int32 step = 1; step <= numOutputs; ++step )
+		{
+			const int32 output = ( lastOutput + step + numOutputs ) % numOutputs;
+			if( mask & ( 1 << output ) )
+			{
+				lastOutput = output;
+				return output;
+			}
+		}
+		return INDEX_NONE;
+	}
+
+	/** Outputs per item class with a rule of its own, bit per output, 0 if the class has no rule. */
+	TArray< uint8 > RuleMasks;
+
+	/** Round robin cursor per item class, the last output an item went to. Classes without a rule share the undefined outputs but not the order. */
+	TArray< int8 > LastOutputs;
+
+	/** Outputs for items without a rule of their own, from the undefined rules and the wildcard outputs. */
+	uint8 UndefinedMask = 0;
+
+	/** Round robin cursor for items without an id, they can't have a cursor of their own. */
+	int8 UnregisteredLastOutput = INDEX_NONE;
+};
+
 /**
  * A smart splitter which you can tell where stuff should go!
  */
@@ -48,6 +146,7 @@ public:
 	virtual void GetLifetimeReplicatedProps( TArray< FLifetimeProperty >& OutLifetimeProps ) const override;
 
 	/** Begin Save Interface */
+	virtual void PreSaveGame_Implementation( int32 saveVersion, int32 gameVersion ) override;
 	virtual void PostLoadGame_Implementation( int32 saveVersion, int32 gameVersion ) override;
 	/** End Save Interface */
 
@@ -90,8 +189,15 @@ private:
 	UFUNCTION()
 	void OnRep_SortRules();
 
-	/** Returns all connections that this item could be placed onto. It excludes wildcard outputs if there is a rule specifically set for this item type */
-	TArray<UFGFactoryConnectionComponent*> GetAllOutputConnectionsForItem( const FInventoryItem& item, float deltaTime ) const;
+	/**
+	 * Compile mSortRules into mSortRuleTable, called when the rules change and on load.
+	 * The round robin cursors, also the ones for classes without a rule, are restored from mItemToLastOutputMap so the order is kept across saves.
+	 * Rules for an output beyond FSplitterSortRuleTable::MAX_OUTPUTS are ignored.
+	 */
+	void CompileSortRules();
+
+	/** Copy the round robin cursors back to mItemToLastOutputMap, called before saving. */
+	void StoreSortRuleCursors();
 
 protected:
 	UPROPERTY( BlueprintAssignable )
@@ -109,9 +215,13 @@ private:
 	UPROPERTY( SaveGame )
 	FInventoryItem mLastItem;
 
+	/** The round robin cursors, only updated from mSortRuleTable when saving. Keyed by class as the item class ids are not persistent. */
 	UPROPERTY( SaveGame )
 	TMap< TSubclassOf< UFGItemDescriptor >, uint8> mItemToLastOutputMap;
 
+	/** mSortRules compiled for routing, see CompileSortRules. */
+	FSplitterSortRuleTable mSortRuleTable;
+
 	UPROPERTY( SaveGame )
 	int32 mLastOutputIndex;
 
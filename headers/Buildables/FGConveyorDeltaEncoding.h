@@ -0,0 +1,167 @@
+// Copyright 2016-2020 Coffee Stain Studios. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Serialization/Archive.h"
+
+/**
+ * Compact wire format for the items in a conveyor delta, used by FConveyorBeltItems::NetDeltaSerialize.
+ *
+ * - Offsets are quantized to OFFSET_PRECISION with just enough bits to cover the belt length.
+ * - Each offset is predicted from the previous one and the spacing, only the residual is sent and a perfectly spaced item costs a single bit.
+ *   The spacing is adapted from the items themselves on both sides, so it does not have to be sent when it changes.
+ * - Item classes are run length encoded, the class ids use as many bits as needed for the classes on the belt, i.e. none on a single class belt.
+ *
+ * All functions are symmetric, the same call is made when saving and loading.
+ */
+struct FConveyorDeltaEncoding
+{
+	/** Offset precision on the wire, in cm. Well below what is visible at belt speeds. */
+	static constexpr float OFFSET_PRECISION = 0.5f;
+
+	/** A sequence of items with the same class id. */
+	struct FItemRun
+	{
+		uint8 ClassID = 0;
+		uint16 Num = 0;
+	};
+
+	/** Number of bits used for a quantized offset on a belt of the given length. */
+	static FORCEINLINE int32 GetOffsetBits( float conveyorLength )
+	{
+		const uint32 maxValue = ( uint32 )FMath::CeilToInt( FMath::Max( conveyorLength, 0.f ) / OFFSET_PRECISION );
+		return FMath::Max( ( int32 )FMath::CeilLogTwo( maxValue + 1 ), 1 );
+	}
+
+	/** Number of bits used for a class id when numClasses distinct classes are on the belt. */
+	static FORCEINLINE int32 GetClassBits( int32 numClasses )
+	{
+		return numClasses > 1 ? ( int32 )FMath::CeilLogTwo( ( uint32 )numClasses ) : 0;
+	}
+
+	static FORCEINLINE int32 QuantizeOffset( float offset, float conveyorLength )
+	{
+		return FMath::RoundToInt( FMath::Clamp( offset, 0.f, conveyorLength ) / OFFSET_PRECISION );
+	}
+
+	static FORCEINLINE float DequantizeOffset( int32 quantized )
+	{
+		return quantized * OFFSET_PRECISION;
+	}
+
+	/** Read or write an unsigned value with a fixed number of bits. */
+	static FORCEINLINE void SerializeFixedBits( FArchive& ar, uint32& value, int32 numBits )
+	{
+		if( numBits <= 0 )
+		{
+			value = 0;
+			return;
+		}
+		if( ar.IsLoading() )
+		{
+			value = 0;
+		}
+		ar.SerializeBits( &value, numBits );
+	}
+
+	/** Read or write a small signed value, zig zag encoded so small magnitudes of both signs are short. */
+	static FORCEINLINE void SerializeSigned( FArchive& ar, int32& value )
+	{
+		uint32 zigZag = ( ( uint32 )value << 1 ) ^ ( uint32 )( value >> 31 );
+		ar.SerializeIntPacked( zigZag );
+		value = ( int32 )( zigZag >> 1 ) ^ -( int32 )( zigZag & 1 );
+	}
+
+	/** Collapse the class ids of the items, in item order, to runs. */
+	static void BuildRuns( const uint8* classIDs, int32 num, TArray< FItemRun >& out_runs )
+	{
+		out_runs.Reset();
+		for( int32 i = 0; i < num; ++i )
+		{
+			if( out_runs.Num() == 0 || out_runs.Last().ClassID != classIDs[ i ] || out_runs.Last().Num == MAX_uint16 )
+			{
+				FItemRun& run = out_runs.AddDefaulted_GetRef();
+				run.ClassID = classIDs[ i ];
+			}
+			++out_runs.Last().Num;
+		}
+	}
+
+	/** Read or write the class runs. */
+	static void SerializeRuns( FArchive& ar, TArray< FItemRun >& runs, int32 numClasses )
+	{
+		uint32 numRuns = runs.Num();
+		ar.SerializeIntPacked( numRuns );
+		if( ar.IsLoading() )
+		{
+			runs.SetNum( numRuns );
+		}
+
+		const int32 classBits = GetClassBits( numClasses );
+		for( FItemRun& run : runs )
+		{
+			uint32 classID = run.ClassID;
+			SerializeFixedBits( ar, classID, classBits );
+			uint32 num = run.Num;
+			ar.SerializeIntPacked( num );
+			run.ClassID = ( uint8 )classID;
+			run.Num = ( uint16 )num;
+		}
+	}
+
+	/**
+	 * Read or write the offsets of items in item order, i.e. descending.
+	 * The first offset is sent in full, the rest as the residual from the previous offset minus the predicted spacing.
+	 * @param offsets - The offsets to write, or filled with the dequantized offsets when loading. Must be sized to the number of items when loading.
+	 * @param conveyorLength - Length of the belt, must be the same on both sides.
+	 * @param predictedSpacing - The spacing both sides predict, updated with the spacing seen in these items for the next delta.
+	 */
+	static void SerializeOffsets( FArchive& ar, TArray< float >& offsets, float conveyorLength, float& predictedSpacing )
+	{
+		const int32 offsetBits = GetOffsetBits( conveyorLength );
+		const int32 quantizedSpacing = FMath::Max( FMath::RoundToInt( predictedSpacing / OFFSET_PRECISION ), 0 );
+
+		int32 previous = 0;
+		int64 gapSum = 0;
+		for( int32 i = 0; i < offsets.Num(); ++i )
+		{
+			int32 quantized = ar.IsSaving() ? QuantizeOffset( offsets[ i ], conveyorLength ) : 0;
+			if( i == 0 )
+			{
+				uint32 value = quantized;
+				SerializeFixedBits( ar, value, offsetBits );
+				quantized = value;
+			}
+			else
+			{
+				const int32 predicted = previous - quantizedSpacing;
+				uint8 isPredicted = ar.IsSaving() && quantized == predicted;
+				ar.SerializeBits( &isPredicted, 1 );
+				if( isPredicted )
+				{
+					quantized = predicted;
+				}
+				else
+				{
+					int32 residual = quantized - predicted;
+					SerializeSigned( ar, residual );
+					quantized = predicted + residual;
+				}
+				gapSum += previous - quantized;
+			}
+
+			if( ar.IsLoading() )
+			{
+				offsets[ i ] = DequantizeOffset( quantized );
+			}
+			previous = quantized;
+		}
+
+		// Adapt to the spacing the belt actually has, both sides see the same quantized offsets so they stay in agreement.
+		if( offsets.Num() > 1 )
+		{
+			predictedSpacing = DequantizeOffset( FMath::RoundToInt( ( float )gapSum / ( offsets.Num() - 1 ) ) );
+		}
+	}
+};
@@ -0,0 +1,112 @@
+// Copyright 2016-2020 Coffee Stain Studios. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/VectorRegister.h"
+
+/**
+ * Kernels operating on the dense offset array of the conveyor belt items.
+ * Offsets are ordered the same way as the items, index 0 is the item closest to the output and has the highest offset.
+ */
+struct FConveyorItemKernels
+{
+	/** Items per block in AdvanceOffsets, a multiple of the vector width. */
+	static constexpr int32 ADVANCE_BLOCK_SIZE = 64;
+
+	/**
+	 * Move all items forward by moveDelta while keeping them at least spacing apart and never beyond headLimit.
+	 * This closes the gaps on a belt where the front item is blocked.
+	 *
+	 * The blocking rule new[i] = min( old[i] + delta, new[i-1] - spacing ) is rewritten as a prefix min so the bulk of the work is vectorized:
+	 * With h[j] = new[b+j] + j * spacing, h[j] = min( old[b+j] + delta + j * spacing, h[j-1] ) and h[-1] = new[b-1] - spacing, or headLimit for the first block.
+	 * The index term is relative to the start of each block of ADVANCE_BLOCK_SIZE items, so it never grows beyond ADVANCE_BLOCK_SIZE * spacing.
+	 * Adding and subtracting it then rounds like the scalar rule does on the offsets themselves, no matter how many items the belt or lane holds.
+	 *
+	 * @note Expects the offsets to already be at least spacing apart and the first offset to be <= headLimit, which the belt guarantees when enqueueing.
+	 *       Under that assumption no item is ever moved backwards.
+	 */
+	static void AdvanceOffsets( float* offsets, int32 num, float moveDelta, float headLimit, float spacing )
+	{
+		const VectorRegister laneSpacing = MakeVectorRegister( 0.f, spacing, 2.f * spacing, 3.f * spacing );
+		const VectorRegister stepSpacing = VectorSetFloat1( 4.f * spacing );
+		const VectorRegister delta = VectorSetFloat1( moveDelta );
+
+		float runningMin = headLimit;
+		for( int32 blockStart = 0; blockStart < num; blockStart += ADVANCE_BLOCK_SIZE )
+		{
+			float* block = offsets + blockStart;
+			const int32 blockNum = FMath::Min( num - blockStart, ADVANCE_BLOCK_SIZE );
+			const int32 numVectorized = blockNum & ~3;
+
+			// Pass 1, g[j] = old[j] + delta + j * spacing
+			VectorRegister indexSpacing = laneSpacing;
+			for( int32 j = 0; j < numVectorized; j += 4 )
+			{
+				VectorStore( VectorAdd( VectorAdd( VectorLoad( block + j ), delta ), indexSpacing ), block + j );
+				indexSpacing = VectorAdd( indexSpacing, stepSpacing );
+			}
+			for( int32 j = numVectorized; j < blockNum; ++j )
+			{
+				block[ j ] += moveDelta + j * spacing;
+			}
+
+			// Pass 2, the running min is the only serial dependency along the belt.
+			for( int32 j = 0; j < blockNum; ++j )
+			{
+				runningMin = FMath::Min( runningMin, block[ j ] );
+				block[ j ] = runningMin;
+			}
+
+			// Pass 3, new[j] = h[j] - j * spacing
+			indexSpacing = laneSpacing;
+			for( int32 j = 0; j < numVectorized; j += 4 )
+			{
+				VectorStore( VectorSubtract( VectorLoad( block + j ), indexSpacing ), block + j );
+				indexSpacing = VectorAdd( indexSpacing, stepSpacing );
+			}
+			for( int32 j = numVectorized; j < blockNum; ++j )
+			{
+				block[ j ] -= j * spacing;
+			}
+
+			// h[-1] for the next block.
+			runningMin = block[ blockNum - 1 ] - spacing;
+		}
+	}
+
+	/**
+	 * Remove all entries flagged as removed from the parallel arrays, keeping the order of the remaining entries.
+	 * @return Number of entries kept, the arrays are shrunk to this size.
+	 */
+	template< typename ClassIDType, typename ColdType >
+	static int32 CompactRemoved( TArray< float >& offsets, TArray< ClassIDType >& classIDs, TArray< uint8 >& removedFlags, TArray< ColdType >& cold )
+	{
+		const int32 num = offsets.Num();
+		int32 writeIdx = 0;
+		for( int32 readIdx = 0; readIdx < num; ++readIdx )
+		{
+			if( removedFlags[ readIdx ] )
+			{
+				continue;
+			}
+			if( writeIdx != readIdx )
+			{
+				offsets[ writeIdx ] = offsets[ readIdx ];
+				classIDs[ writeIdx ] = classIDs[ readIdx ];
+				removedFlags[ writeIdx ] = 0;
+				cold[ writeIdx ] = MoveTemp( cold[ readIdx ] );
+			}
+			++writeIdx;
+		}
+
+		if( writeIdx != num )
+		{
+			offsets.SetNum( writeIdx, false );
+			classIDs.SetNum( writeIdx, false );
+			removedFlags.SetNum( writeIdx, false );
+			cold.SetNum( writeIdx, false );
+		}
+		return writeIdx;
+	}
+};
@@ -0,0 +1,206 @@
+// Copyright 2016-2020 Coffee Stain Studios. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/SubclassOf.h"
+
+using FG_ConveyorItemRepKeyType = int16;
+using FG_ConveyorVersionType = int8;
+
+/** Replicated state of a single item on a belt at one replication version. */
+struct FConveyorItemHolder
+{
+	FConveyorItemHolder( FG_ConveyorItemRepKeyType _id, bool _removed, float _offset ) : RepID( _id ), Removed( _removed ), Offset(_offset){}
+	FG_ConveyorItemRepKeyType RepID;
+	bool Removed = false;
+	//@TODO:[DavalliusA:Tue/11-06-2019] remove this? We probably don't need this. But actually, we probably don't need this whole list. Just holding first and last IDs should be enough. Reconsider this implementation to save memory.
+	float Offset; //[DavalliusA:Tue/14-05-2019] used to store a position, so we can accurately predict what item to remove when getting a pickup event from a client.
+	//@TODO:[DavalliusA:Tue/14-05-2019] consider how to handle pickups happening on the edge of a conveyor, but it should be an no issue once we merge?
+	inline bool operator!=( const FConveyorItemHolder& B ) const
+	{
+		return B.RepID != RepID || B.Removed != Removed;
+	}
+	inline bool operator==( const FConveyorItemHolder& B ) const
+	{
+		return B.RepID == RepID && B.Removed == Removed;
+	}
+};
+
+/**
+ * The items and class bit ids of a belt at one replication version.
+ * A snapshot is written once when the version is created and is then shared, read only, between the belt's history and the delta base states of all clients.
+ * Snapshots are recycled through FConveyorItemSnapshotPool and keep their array allocations, so a warmed up server does not allocate when sending deltas.
+ */
+struct FConveyorItemSnapshot
+{
+	FConveyorItemSnapshot() {}
+
+	/** Copy the content but keep our own allocations. */
+	void CopyFrom( const FConveyorItemSnapshot& other )
+	{
+		ItemList.Reset();
+		ItemList.Append( other.ItemList );
+		BitIDToType.Reset();
+		BitIDToType.Append( other.BitIDToType );
+	}
+
+	/** Clear the content but keep the allocations, used when returned to the pool. */
+	void Reset()
+	{
+		ItemList.Reset();
+		BitIDToType.Reset();
+	}
+
+	/** @return the bit id for an item class, INDEX_NONE if the class has none. */
+	FORCEINLINE int32 FindBitID( TSubclassOf< class UFGItemDescriptor > type ) const
+	{
+		return BitIDToType.IndexOfByKey( type );
+	}
+
+	/** Get the bit id for an item class, assigns the next one if the class has none. Belts rarely carry more than a couple of classes so a linear search is fine. */
+	FORCEINLINE uint8 FindOrAddBitID( TSubclassOf< class UFGItemDescriptor > type )
+	{
+		const int32 bitID = BitIDToType.AddUnique( type );
+		check( bitID <= MAX_uint8 );
+		return ( uint8 )bitID;
+	}
+
+	bool IsContentEqual( const FConveyorItemSnapshot& other ) const
+	{
+		return ItemList == other.ItemList && BitIDToType == other.BitIDToType;
+	}
+
+	TArray< FConveyorItemHolder > ItemList;
+
+	/** Translation of the bit ids sent on the wire to an item class, the index is the id. Replaces the TypeToBitIDMap that was copied for every base state. */
+	TArray< TSubclassOf< class UFGItemDescriptor >, TInlineAllocator< 4 > > BitIDToType;
+
+private:
+	friend struct FConveyorItemSnapshotRef;
+	friend class FConveyorItemSnapshotPool;
+
+	/** Number of FConveyorItemSnapshotRef pointing at this, only touched from the game thread where replication runs. */
+	int32 RefCount = 0;
+};
+
+/**
+ * Shared pool of snapshots for all belts.
+ * Only used from the game thread.
+ */
+class FACTORYGAME_API FConveyorItemSnapshotPool
+{
+public:
+	/** Maximum number of unused snapshots kept around, the rest are deleted when released. */
+	static const int32 MAX_POOLED_SNAPSHOTS = 8192;
+
+	/** Get an empty snapshot, from the pool if there is one. */
+	static FConveyorItemSnapshot* Allocate();
+
+	/** Return a snapshot that no one references anymore. */
+	static void Release( FConveyorItemSnapshot* snapshot );
+
+	/** Delete all pooled snapshots, e.g. when the world is torn down. */
+	static void Trim();
+
+	/** Number of unused snapshots in the pool, for stats. */
+	static int32 NumPooled();
+};
+
+/**
+ * Reference counted handle to a snapshot with copy on write.
+ * Copying the handle only shares the snapshot, MakeUnique must be used before modifying it.
+ */
+struct FConveyorItemSnapshotRef
+{
+	FConveyorItemSnapshotRef() {}
+
+	FConveyorItemSnapshotRef( const FConveyorItemSnapshotRef& other ) :
+		Snapshot( other.Snapshot )
+	{
+		AddRef();
+	}
+
+	FConveyorItemSnapshotRef( FConveyorItemSnapshotRef&& other ) :
+		Snapshot( other.Snapshot )
+	{
+		other.Snapshot = nullptr;
+	}
+
+	~FConveyorItemSnapshotRef()
+	{
+		Reset();
+	}
+
+	FConveyorItemSnapshotRef& operator=( const FConveyorItemSnapshotRef& other )
+	{
+		if( Snapshot != other.Snapshot )
+		{
+			Reset();
+			Snapshot = other.Snapshot;
+			AddRef();
+		}
+		return *this;
+	}
+
+	FConveyorItemSnapshotRef& operator=( FConveyorItemSnapshotRef&& other )
+	{
+		if( this != &other )
+		{
+			Reset();
+			Snapshot = other.Snapshot;
+			other.Snapshot = nullptr;
+		}
+		return *this;
+	}
+
+	FORCEINLINE bool IsValid() const { return Snapshot != nullptr; }
+
+	/** Read only access, the snapshot may be shared. */
+	FORCEINLINE const FConveyorItemSnapshot* Get() const { return Snapshot; }
+	FORCEINLINE const FConveyorItemSnapshot* operator->() const { return Snapshot; }
+
+	/** @return true if both handles point at the same snapshot, i.e. the states are equal without comparing the content. */
+	FORCEINLINE bool IsSameSnapshot( const FConveyorItemSnapshotRef& other ) const { return Snapshot == other.Snapshot; }
+
+	/** Get a writable snapshot. Allocates one if we have none, and copies it first if it's shared. */
+	FConveyorItemSnapshot& MakeUnique()
+	{
+		if( !Snapshot )
+		{
+			Snapshot = FConveyorItemSnapshotPool::Allocate();
+			Snapshot->RefCount = 1;
+		}
+		else if( Snapshot->RefCount > 1 )
+		{
+			FConveyorItemSnapshot* copy = FConveyorItemSnapshotPool::Allocate();
+			copy->CopyFrom( *Snapshot );
+			copy->RefCount = 1;
+			Reset();
+			Snapshot = copy;
+		}
+		return *Snapshot;
+	}
+
+	/** Drop our reference, the snapshot goes back to the pool when the last reference is dropped. */
+	void Reset()
+	{
+		if( Snapshot && --Snapshot->RefCount == 0 )
+		{
+			FConveyorItemSnapshotPool::Release( Snapshot );
+		}
+		Snapshot = nullptr;
+	}
+
+private:
+	FORCEINLINE void AddRef()
+	{
+		if( Snapshot )
+		{
+			++Snapshot->RefCount;
+		}
+	}
+
+private:
+	FConveyorItemSnapshot* Snapshot = nullptr;
+};
@@ -0,0 +1,194 @@
+// Copyright 2016-2020 Coffee Stain Studios. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Algo/BinarySearch.h"
+#include "FGInventoryComponent.h"
+#include "FGConveyorItemKernels.h"
+
+/**
+ * A conveyor bucket simulated as one continuous lane with a single item queue.
+ *
+ * Lane offsets run from 0 at the input of the last conveyor in the bucket to Length at the output of the first conveyor,
+ * i.e. the conveyors are laid out in the reverse bucket order. Items are ordered like on a belt, index 0 is closest to the output.
+ * Per conveyor offsets are only derived when a conveyor needs them, e.g. when significant or when saving.
+ * Items leaving the output only move a head index, the dequeued slots are compacted away once they make up half the storage.
+ */
+struct FConveyorLane
+{
+public:
+	/** @return true if the bucket is currently simulated as a lane. */
+	FORCEINLINE bool IsActive() const { return SegmentStartOffsets.Num() > 0; }
+
+	FORCEINLINE float GetLength() const { return Length; }
+	FORCEINLINE float GetSpeed() const { return Speed; }
+	FORCEINLINE int32 NumItems() const { return Items.Num() - Head; }
+	FORCEINLINE int32 NumSegments() const { return SegmentStartOffsets.Num(); }
+
+	/** Set up the segments, lengths must be in bucket order (output to input). All segments must run at the same speed. */
+	void Setup( const TArray< float >& segmentLengths, float speed )
+	{
+		Reset();
+		Speed = speed;
+		SegmentStartOffsets.SetNumUninitialized( segmentLengths.Num() );
+		for( int32 i = segmentLengths.Num() - 1; i >= 0; --i )
+		{
+			SegmentStartOffsets[ i ] = Length;
+			Length += segmentLengths[ i ];
+		}
+	}
+
+	/** Remove all segments and items. */
+	void Reset()
+	{
+		SegmentStartOffsets.Reset();
+		Items.Reset();
+		ItemOffsets.Reset();
+		Head = 0;
+		Length = 0.f;
+		Speed = 0.f;
+	}
+
+	/** Get the lane offset where the given segment starts. */
+	FORCEINLINE float GetSegmentStartOffset( int32 segmentIdx ) const { return SegmentStartOffsets[ segmentIdx ]; }
+
+	/** Get the length of the given segment. */
+	FORCEINLINE float GetSegmentLength( int32 segmentIdx ) const
+	{
+		const float segmentEnd = segmentIdx > 0 ? SegmentStartOffsets[ segmentIdx - 1 ] : Length;
+		return segmentEnd - SegmentStartOffsets[ segmentIdx ];
+	}
+
+	/**
+	 * Get the items on a segment, the range is in item order.
+	 * The item offsets are descending so both ends are found with a binary search.
+	 */
+	void GetItemRangeForSegment( int32 segmentIdx, int32& out_firstItem, int32& out_numItems ) const
+	{
+		const float segmentStart = SegmentStartOffsets[ segmentIdx ];
+		const float segmentEnd = segmentIdx > 0 ? SegmentStartOffsets[ segmentIdx - 1 ] : Length;
+
+		// First item strictly before the end of the segment, except the last segment which owns the items at the very end.
+		out_firstItem = segmentIdx > 0 ? FindFirstItemBelow( segmentEnd ) : 0;
+		// First item that is before the start of the segment.
+		const int32 endItem = FindFirstItemBelow( segmentStart );
+		out_numItems = FMath::Max( endItem - out_firstItem, 0 );
+	}
+
+	/** Get the offset of an item relative to the segment it is on. */
+	FORCEINLINE float GetLocalOffset( int32 segmentIdx, int32 itemIdx ) const
+	{
+		return ItemOffsets[ Head + itemIdx ] - SegmentStartOffsets[ segmentIdx ];
+	}
+
+	FORCEINLINE const FInventoryItem& GetItem( int32 itemIdx ) const { return Items[ Head + itemIdx ]; }
+	FORCEINLINE float GetItemOffset( int32 itemIdx ) const { return ItemOffsets[ Head + itemIdx ]; }
+
+	/** Move all items, the first item can not pass headLimit (the lane length, or less if the output is blocked). */
+	FORCEINLINE void Advance( float dt, float headLimit, float spacing )
+	{
+		FConveyorItemKernels::AdvanceOffsets( ItemOffsets.GetData() + Head, NumItems(), Speed * dt, FMath::Min( headLimit, Length ), spacing );
+	}
+
+	/** How much room there is at the input of the lane. */
+	FORCEINLINE float GetAvailableSpaceAtInput() const
+	{
+		return NumItems() > 0 ? ItemOffsets.Last() : Length;
+	}
+
+	/** Put a new item at the input of the lane. */
+	FORCEINLINE void EnqueueAtInput( const FInventoryItem& item, float offset )
+	{
+		Items.Add( item );
+		ItemOffsets.Add( offset );
+	}
+
+	/** Insert an item keeping the order, used when a lane is built from conveyors that already has items on them. */
+	void InsertSorted( const FInventoryItem& item, float offset )
+	{
+		const int32 index = Head + FindFirstItemBelow( offset );
+		Items.Insert( item, index );
+		ItemOffsets.Insert( offset, index );
+	}
+
+	/**
+	 * Remove any item from the lane, e.g. when picked up by a player from a conveyor simulated by the lane.
+	 * All removals of lane items must go through here (or DequeueAtOutput), the conveyors only hold a copy that is overwritten when materialized.
+	 */
+	FInventoryItem RemoveItemAt( int32 itemIdx )
+	{
+		if( itemIdx == 0 )
+		{
+			float offsetBeyond;
+			return DequeueAtOutput( offsetBeyond );
+		}
+
+		FInventoryItem item = Items[ Head + itemIdx ];
+		Items.RemoveAt( Head + itemIdx, 1, false );
+		ItemOffsets.RemoveAt( Head + itemIdx, 1, false );
+		return item;
+	}
+
+	/** @return true if the first item has reached the output of the lane. */
+	FORCEINLINE bool HasItemAtOutput() const
+	{
+		return NumItems() > 0 && ItemOffsets[ Head ] >= Length;
+	}
+
+	/** Take the first item, how far it has traveled beyond the end of the lane is returned in out_offsetBeyond. Amortized constant time. */
+	FORCEINLINE FInventoryItem DequeueAtOutput( float& out_offsetBeyond )
+	{
+		out_offsetBeyond = FMath::Max( ItemOffsets[ Head ] - Length, 0.f );
+		FInventoryItem item = Items[ Head ];
+		++Head;
+		CompactHead();
+		return item;
+	}
+
+private:
+	/** Drop the dequeued slots in front of Head once they make up half the storage, so each item is moved at most once on average. */
+	FORCEINLINE void CompactHead()
+	{
+		if( Head == Items.Num() )
+		{
+			Items.Reset();
+			ItemOffsets.Reset();
+			Head = 0;
+		}
+		else if( Head >= MIN_HEAD_TO_COMPACT && Head * 2 >= Items.Num() )
+		{
+			Items.RemoveAt( 0, Head, false );
+			ItemOffsets.RemoveAt( 0, Head, false );
+			Head = 0;
+		}
+	}
+
+	/** Index of the first item with an offset lower than the given offset, NumItems() if none. Relative to Head. */
+	int32 FindFirstItemBelow( float offset ) const
+	{
+		return Algo::LowerBound( MakeArrayView( ItemOffsets.GetData() + Head, NumItems() ), offset, []( float itemOffset, float value ) { return itemOffset >= value; } );
+	}
+
+	/** Don't compact for only a few dequeued items, the move is not worth it. */
+	static constexpr int32 MIN_HEAD_TO_COMPACT = 16;
+
+private:
+	/** Lane offset where each conveyor starts, in bucket order. */
+	TArray< float > SegmentStartOffsets;
+
+	/** Total length of all conveyors in the lane. */
+	float Length = 0.f;
+
+	/** Speed of all conveyors in the lane. */
+	float Speed = 0.f;
+
+	/** All items on the lane, Head is the item closest to the output. Slots before Head have been dequeued. */
+	TArray< FInventoryItem > Items;
+
+	/** Offsets for the items in range [0,Length], same indices as Items. */
+	TArray< float > ItemOffsets;
+
+	/** Index in Items and ItemOffsets of the first item still on the lane. */
+	int32 Head = 0;
+};
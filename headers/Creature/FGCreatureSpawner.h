@@ -5,6 +5,7 @@
 #include "GameFramework/Actor.h"
 #include "FGCreature.h"
 #include "FGSaveInterface.h"
+#include "FGSpawnPointSolver.h"
 #include "FGCreatureSpawner.generated.h"
 
 /** Data we need to know/save about spawns in this spawner */
@@ -58,6 +59,7 @@ public:
 
 	// BEGIN AActor interface
 	virtual void BeginPlay() override;
+	virtual void EndPlay( const EEndPlayReason::Type endPlayReason ) override;
 
 	/** Moved in the editor, on done, calculate spawn locations */
 	#if WITH_EDITOR
@@ -127,6 +129,7 @@ public:
 
 	/**
 	* Calculates the locations of the spawn locations of the enemies
+	* Uses the cached spawn points from the solver when valid, else solves them on the calling thread.
 	* @returns false if we didn't manage to fit all the enemies is the radius
 	**/
 	UFUNCTION( BlueprintCallable, Category = "Spawning", meta = ( CallInEditor = "true" ) )
@@ -155,7 +158,28 @@ public:
 
 	/** Try and recouple creatures that are in this instances mSpawnData but has no spawner set */
 	void TryRecoupleCreatureAndSpawner();
+
+	/**
+	 * Start solving the spawn points in the background if the cached ones are missing or stale.
+	 * Called ahead of activation, e.g. when a player enters the spawner's grid neighbourhood, so the points are ready when spawning.
+	 */
+	void RequestSpawnPoints();
+
+	/** @return true if the cached spawn points are valid for the current spawner settings. */
+	bool HasValidSpawnPoints() const;
+
+	/** Drop the cached spawn points, e.g. when something is built or dismantled close to the spawner. */
+	void InvalidateSpawnPoints();
 protected:
+	/**
+	 * Pick up the result of the spawn point solver if it is done and start the ground and overlap checks on the solved candidates.
+	 * @return true if the cached spawn points are valid.
+	 */
+	bool PollSpawnPointSolver();
+
+	/** Hash of the inputs to the spawn point solver for the current settings. */
+	uint32 GetSpawnPointsHash() const;
+
 	/** Randoms a location within range of this actor, and randoms new locations trying to find a unused location numRetries times */
 	bool TryFindNonOverlappingLocation( const TArray<FVector2D>& usedSpawnLocations, float spawnRadius, int32 maxRetries, FVector2D& out_location );
 
@@ -250,6 +274,23 @@ protected:
 private:
 	UPROPERTY( SaveGame )
 	int32 mRandomSeed;
+
+	/**
+	 * Spawn locations in world space that passed the ground trace and the overlap check.
+	 * Only filled in once the checks are done, so a cache hit skips both the solver and the traces. Saved so they are not redone every session.
+	 */
+	UPROPERTY( SaveGame )
+	TArray< FVector > mCachedSpawnPoints;
+
+	/** Inputs the cached spawn points were solved for, 0 if invalidated. */
+	UPROPERTY( SaveGame )
+	uint32 mCachedSpawnPointsHash;
+
+	/** Candidates from the solver waiting for the ground and overlap checks, offsets from the spawner location. */
+	TArray< FVector2D > mPendingSpawnPoints;
+
+	/** The spawn point solver running in the background, null if not solving. */
+	TUniquePtr< FAsyncTask< FSpawnPointSolverTask > > mSpawnPointSolver;
 public: 
 	/** Should this spawner draw a sphere showing its spawn distance in editor */
 	UPROPERTY( EditAnywhere, Category = "Spawning" )
@@ -259,7 +300,7 @@ public:
 	UPROPERTY( EditInstanceOnly, Category = "Spawning" )
 	int32 mRespawnTimeIndays;
 
-	/** Async overlap check is done and result is passed in here */
+	/** Async overlap check is done and result is passed in here, the candidates that passed are stored in mCachedSpawnPoints */
 	UFUNCTION()
 	void ReceiveOnTraceCompleted( const TArray< FOverlapResult > & Results );
 
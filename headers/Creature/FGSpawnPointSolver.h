@@ -0,0 +1,150 @@
+// Copyright 2016-2020 Coffee Stain Studios. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/AsyncWork.h"
+
+/**
+ * Poisson disk sampling of points in a circle, i.e. random points that are never closer than a minimum distance to each other.
+ * Uses the background grid from Bridson's algorithm so each candidate is only tested against the points in the surrounding cells.
+ */
+struct FPoissonDiskSampler
+{
+	/** How many candidates are tried around an active point before it is retired. */
+	static constexpr int32 CANDIDATES_PER_POINT = 30;
+
+	/**
+	 * Sample up to maxPoints points within radius from the origin.
+	 * @return false if fewer than maxPoints fit.
+	 */
+	static bool Sample( FRandomStream& stream, float radius, float minDistance, int32 maxPoints, TArray< FVector2D >& out_points )
+	{
+		out_points.Reset();
+		if( maxPoints <= 0 )
+		{
+			return true;
+		}
+
+		minDistance = FMath::Max( minDistance, 1.f );
+		const float cellSize = minDistance / FMath::Sqrt( 2.f );
+		const int32 gridSize = FMath::CeilToInt( 2.f * radius / cellSize ) + 1;
+		const float minDistanceSq = FMath::Square( minDistance );
+
+		// Index into out_points per cell, a cell can hold at most one point.
+		TArray< int32 > grid;
+		grid.Init( INDEX_NONE, gridSize * gridSize );
+		auto toCell = [ & ]( const FVector2D& point )
+		{
+			return FIntPoint( FMath::Clamp( FMath::FloorToInt( ( point.X + radius ) / cellSize ), 0, gridSize - 1 ),
+							  FMath::Clamp( FMath::FloorToInt( ( point.Y + radius ) / cellSize ), 0, gridSize - 1 ) );
+		};
+		auto addPoint = [ & ]( const FVector2D& point )
+		{
+			const FIntPoint cell = toCell( point );
+			grid[ cell.Y * gridSize + cell.X ] = out_points.Add( point );
+		};
+		auto isFree = [ & ]( const FVector2D& point )
+		{
+			const FIntPoint cell = toCell( point );
+			for( int32 y = FMath::Max( cell.Y - 2, 0 ); y <= FMath::Min( cell.Y + 2, gridSize - 1 ); ++y )
+			{
+				for( int32 x = FMath::Max( cell.X - 2, 0 ); x <= FMath::Min( cell.X + 2, gridSize - 1 ); ++x )
+				{
+					const int32 other = grid[ y * gridSize + x ];
+					if( other != INDEX_NONE && FVector2D::DistSquared( out_points[ other ], point ) < minDistanceSq )
+					{
+						return false;
+					}
+				}
+			}
+			return true;
+		};
+
+		addPoint( RandomPointInCircle( stream, radius ) );
+		TArray< int32 > active;
+		active.Add( 0 );
+		while( active.Num() > 0 && out_points.Num() < maxPoints )
+		{
+			const int32 activeIdx = stream.RandHelper( active.Num() );
+			const FVector2D origin = out_points[ active[ activeIdx ] ];
+
+			bool foundCandidate = false;
+			for( int32 i = 0; i < CANDIDATES_PER_POINT; ++i )
+			{
+				// Candidates are taken from the annulus [minDistance, 2 * minDistance] around the active point.
+				const float angle = stream.FRandRange( 0.f, 2.f * PI );
+				const float distance = minDistance * FMath::Sqrt( stream.FRandRange( 1.f, 4.f ) );
+				const FVector2D candidate = origin + FVector2D( FMath::Cos( angle ), FMath::Sin( angle ) ) * distance;
+				if( candidate.SizeSquared() <= FMath::Square( radius ) && isFree( candidate ) )
+				{
+					active.Add( out_points.Num() );
+					addPoint( candidate );
+					foundCandidate = true;
+					break;
+				}
+			}
+
+			if( !foundCandidate )
+			{
+				active.RemoveAtSwap( activeIdx );
+			}
+		}
+
+		// The points grow outwards from the first one, shuffle so a partial set is not clumped on one side.
+		for( int32 i = out_points.Num() - 1; i > 0; --i )
+		{
+			out_points.Swap( i, stream.RandHelper( i + 1 ) );
+		}
+		return out_points.Num() >= maxPoints;
+	}
+
+	static FVector2D RandomPointInCircle( FRandomStream& stream, float radius )
+	{
+		const float angle = stream.FRandRange( 0.f, 2.f * PI );
+		const float distance = radius * FMath::Sqrt( stream.FRand() );
+		return FVector2D( FMath::Cos( angle ), FMath::Sin( angle ) ) * distance;
+	}
+};
+
+/**
+ * Background task computing the spawn points of a creature spawner.
+ * Only the 2D layout is solved here, it does not touch the world. The points are candidates, the spawner runs the ground and overlap checks
+ * on them and caches the locations that pass.
+ */
+class FSpawnPointSolverTask : public FNonAbandonableTask
+{
+	friend class FAsyncTask< FSpawnPointSolverTask >;
+public:
+	FSpawnPointSolverTask( int32 randomSeed, float spawnRadius, float minDistance, int32 numPoints ) :
+		RandomSeed( randomSeed ),
+		SpawnRadius( spawnRadius ),
+		MinDistance( minDistance ),
+		NumPoints( numPoints ),
+		FoundAllPoints( false )
+	{
+	}
+
+	void DoWork()
+	{
+		FRandomStream stream( RandomSeed );
+		FoundAllPoints = FPoissonDiskSampler::Sample( stream, SpawnRadius, MinDistance, NumPoints, Points );
+	}
+
+	FORCEINLINE TStatId GetStatId() const { RETURN_QUICK_DECLARE_CYCLE_STAT( FSpawnPointSolverTask, STATGROUP_ThreadPoolAsyncTasks ); }
+
+	/** Hash of the inputs, the spawner keeps its cached points as long as the hash matches. */
+	static uint32 HashInputs( int32 randomSeed, float spawnRadius, float minDistance, int32 numPoints )
+	{
+		return HashCombine( HashCombine( GetTypeHash( randomSeed ), GetTypeHash( spawnRadius ) ), HashCombine( GetTypeHash( minDistance ), GetTypeHash( numPoints ) ) );
+	}
+
+	/** Results, read after the task is done. Offsets from the spawner location. */
+	TArray< FVector2D > Points;
+
+	int32 RandomSeed;
+	float SpawnRadius;
+	float MinDistance;
+	int32 NumPoints;
+	bool FoundAllPoints;
+};
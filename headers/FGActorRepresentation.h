@@ -174,11 +174,15 @@ private:
 	UPROPERTY( Replicated )
 	AActor* mRealActor;
 
-	/** This is the actor location */
+	/**
+	 * This is the actor location
+	 * Replicated with COND_InitialOnly, all later changes are sent through AFGActorRepresentationManager's position batches,
+	 * moving representations every batch they changed and the others when moved with UpdateRepresentation.
+	 */
 	UPROPERTY( Replicated )
 	FVector_NetQuantize mActorLocation;
 
-	/** This is the actor rotation */
+	/** This is the actor rotation, replicated with COND_InitialOnly, see mActorLocation */
 	UPROPERTY( Replicated )
 	FRotator mActorRotation;
 
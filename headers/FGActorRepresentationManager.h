@@ -4,6 +4,7 @@
 
 #include "FGSubsystem.h"
 #include "FGActorRepresentation.h"
+#include "FGRepresentationReplication.h"
 #include "FGActorRepresentationManager.generated.h"
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam( FOnActorRepresentationAdded, UFGActorRepresentation*, newRepresentation );
@@ -41,6 +42,7 @@ public:
 	UFUNCTION( BlueprintCallable, Category = "Representation" )
 	bool CreateAndAddNewRepresentation( AActor* realActor, bool isLocal = false );
 
+	/** Update a representation from its actor. If it moved and is not a moving representation it is added to the next position batch. */
 	UFUNCTION( BlueprintCallable, Category = "Representation" )
 	bool UpdateRepresentation( AActor* realActor, bool isLocal = false );
 
@@ -48,7 +50,7 @@ public:
 	UFUNCTION( BlueprintCallable, Category = "Representation" )
 	bool CreateAndAddNewRepresentationNoActor( FVector location, class UTexture2D* compassTexture, FLinearColor compassColor, float lifeTime, bool shouldShowInCompass, bool shouldShowOnMap, ERepresentationType representationType = ERepresentationType::RT_Default, bool isLocal = true );
 
-	/** Removes the representation of an actor */
+	/** Removes the representation of an actor, also from every connection interest */
 	UFUNCTION( BlueprintCallable, BlueprintAuthorityOnly, Category = "Representation" )
 	bool RemoveRepresentationOfActor( AActor* realActor );
 
@@ -84,15 +86,57 @@ public:
 	UFUNCTION( BlueprintPure, Category = "Filtering" )
 	float GetDistanceValueFromCompassViewDistance( ECompassViewDistance compassViewDistance );
 
+	/**
+	 * Client only, apply a batch of positions for the moving representations. Received through the player controller, entries that did not resolve are skipped.
+	 * The player controller acknowledges the batch to the server with Server_AckRepresentationPositions.
+	 * Skipped entries are fine, the representation gets its current location with its initial replication.
+	 */
+	void ApplyRepresentationPositions( const FRepresentationPositionBatch& batch );
+
+	/** Server only, a connection received the batch with the given sequence, see FRepresentationConnectionInterest::AcknowledgeBatch. */
+	void AcknowledgeRepresentationPositions( class UNetConnection* connection, uint32 sequence );
+
 protected:
 	// Begin AActor interface
+	/** Only updates the moving and temporary representations, static ones are updated when their actor calls UpdateRepresentation. */
 	virtual void Tick( float dt ) override;
 	// End AActor interface
 
 private:
+	/**
+	 * Representations that are not relevant to this client are never replicated to it and are null in mReplicatedRepresentations, they are skipped.
+	 * They are added when they resolve, which calls this again.
+	 */
 	UFUNCTION()
 	void OnRep_ReplicatedRepresentations();
 
+	/**
+	 * Client only, run the interest test on the local player's filters and pawn location.
+	 * Representations that failed it are removed as the server has stopped updating them, and are added back when they pass again.
+	 */
+	void UpdateClientRelevancy();
+
+	/**
+	 * Server only, refresh the interest of every connection from its player's filters and view location.
+	 * Connections that have closed are removed. Called every mInterestUpdateInterval and when a player changes a filter.
+	 */
+	void UpdateConnectionInterests();
+
+	/** Server only, get the interest for a connection, created with everything relevant if the connection has no interest yet. */
+	FRepresentationConnectionInterest& GetOrAddConnectionInterest( class UNetConnection* connection );
+
+	/**
+	 * Server only, send the positions of the relevant moving representations that changed to each connection in one batch.
+	 * Also includes the representations in mPositionDirtyRepresentations, which are cleared afterwards.
+	 */
+	void SendRepresentationPositions();
+
+	/** Server only, remove a representation from every connection interest, called when the representation is removed. */
+	void RemoveFromConnectionInterests( UFGActorRepresentation* representation );
+
+	/** Add or remove a representation from mMovingRepresentations depending on if it is static and temporary. */
+	void UpdateMovingRepresentation( UFGActorRepresentation* representation );
+
 public:
 	/** Called whenever a new representation is added */
 	UPROPERTY( BlueprintAssignable, Category = "Representation" )
@@ -134,4 +178,35 @@ private:
 	/** These are representation that the local player adds for them selves, often temporary stuff that others shouldn't see */
 	UPROPERTY()
 	TArray< UFGActorRepresentation* > mLocalRepresentations;
+
+	/** Representations that are not static or are temporary, the only ones updated in Tick */
+	UPROPERTY()
+	TArray< UFGActorRepresentation* > mMovingRepresentations;
+
+	/** Client only, replicated representations removed by UpdateClientRelevancy, kept to be added back when they become relevant again */
+	UPROPERTY()
+	TArray< UFGActorRepresentation* > mClientIrrelevantRepresentations;
+
+	/**
+	 * Server only, what each client connection is interested in.
+	 * Weak keys so a closed connection never dangles, closed connections are removed in UpdateConnectionInterests.
+	 */
+	TMap< TWeakObjectPtr< class UNetConnection >, FRepresentationConnectionInterest > mConnectionInterests;
+
+	/**
+	 * Server only, representations not in mMovingRepresentations that were moved through UpdateRepresentation.
+	 * Their location only replicates initially, so the change is sent with the next position batch.
+	 */
+	TSet< TWeakObjectPtr< UFGActorRepresentation > > mPositionDirtyRepresentations;
+
+	/** How often the connection interests are refreshed, in seconds */
+	UPROPERTY( EditDefaultsOnly, Category = "Replication" )
+	float mInterestUpdateInterval;
+
+	/** How often the positions of the moving representations are sent, in seconds */
+	UPROPERTY( EditDefaultsOnly, Category = "Replication" )
+	float mPositionUpdateInterval;
+
+	float mInterestUpdateTimer;
+	float mPositionUpdateTimer;
 };
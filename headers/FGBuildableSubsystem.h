@@ -7,11 +7,15 @@
 #include "FGSaveInterface.h"
 #include "FGBuildingColorSlotStruct.h"
 #include "FactoryTick.h"
+#include "FactoryTickScheduler.h"
+#include "FGConveyorLane.h"
+#include "FGFactorySteadyState.h"
 #include "FGBuildableSubsystem.generated.h"
 
 class UFGProductionIndicatorInstanceManager;
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam( FOnBuildableConstructedGlobal, AFGBuildable*, buildable );
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam( FOnBuildableRemovedGlobal, AFGBuildable*, buildable );
 
 /** Used to track constructed (spawned) buildables matched with their holograms between client and server */
 USTRUCT()
@@ -78,8 +82,95 @@ struct FConveyorBucket
 
 	FConveyorBucket(){}
 
+	/** Index of the conveyor with the given bucket position, positions are assigned from PositionBase and up in conveyor order. */
+	FORCEINLINE int32 GetIndexForPosition( int32 position ) const { return position - PositionBase; }
+
+	/** Position to assign to the conveyor at the given index. */
+	FORCEINLINE int32 GetPositionForIndex( int32 index ) const { return PositionBase + index; }
+
+	/** Number of conveyors in the bucket. */
+	FORCEINLINE int32 NumConveyors() const { return Conveyors.Num() - Head; }
+
+	FORCEINLINE class AFGBuildableConveyorBase* GetConveyor( int32 index ) const { return Conveyors[ Head + index ]; }
+
+	/** The conveyors in order, index 0 is the first conveyor. Only valid until the bucket is modified. */
+	FORCEINLINE TArrayView< class AFGBuildableConveyorBase* const > GetConveyors() const { return MakeArrayView( Conveyors.GetData() + Head, NumConveyors() ); }
+
+	FORCEINLINE void AddConveyor( class AFGBuildableConveyorBase* conveyor ) { Conveyors.Add( conveyor ); }
+
+	/** Put a conveyor first, amortized constant time. The caller decrements PositionBase so the other conveyors keep their positions. */
+	void PrependConveyor( class AFGBuildableConveyorBase* conveyor )
+	{
+		if( Head == 0 )
+		{
+			// Open up as much room at the front as there are conveyors, so a run of prepends only moves the conveyors log n times.
+			const int32 slack = FMath::Max( NumConveyors(), MIN_FRONT_SLACK );
+			Conveyors.InsertZeroed( 0, slack );
+			Head = slack;
+		}
+		Conveyors[ --Head ] = conveyor;
+	}
+
+	/** Remove the first conveyor, amortized constant time. The caller increments PositionBase so the other conveyors keep their positions. */
+	void RemoveFirstConveyor()
+	{
+		Conveyors[ Head++ ] = nullptr;
+		if( Head == Conveyors.Num() )
+		{
+			Conveyors.Reset();
+			Head = 0;
+		}
+		else if( Head > MIN_FRONT_SLACK && Head * 2 > Conveyors.Num() )
+		{
+			Conveyors.RemoveAt( 0, Head, false );
+			Head = 0;
+		}
+	}
+
+	void RemoveLastConveyor()
+	{
+		Conveyors.Pop( false );
+		if( Head == Conveyors.Num() )
+		{
+			Conveyors.Reset();
+			Head = 0;
+		}
+	}
+
+	/** Remove all conveyors, e.g. when the bucket is released. */
+	FORCEINLINE void ResetConveyors() { Conveyors.Reset(); Head = 0; }
+
+private:
+	/** Free slots kept at the front at least, avoids moving the conveyors for every single prepend on short buckets. */
+	static constexpr int32 MIN_FRONT_SLACK = 8;
+
+	/**
+	 * The conveyors from Head and up, in order. The slots before Head are null.
+	 * The slots at the front let us prepend and remove the first conveyor without moving the rest of the array.
+	 */
 	UPROPERTY()
 	TArray< class AFGBuildableConveyorBase* > Conveyors;
+
+	/** Index in Conveyors of the first conveyor. */
+	int32 Head = 0;
+
+public:
+
+	/** Stable id of this bucket, the index in mConveyorBuckets. Never changes while the bucket is in use. */
+	int32 BucketID = INDEX_NONE;
+
+	/**
+	 * Bucket position of the first conveyor. Positions are only relative within the bucket and can be negative.
+	 * Together with the front slots in Conveyors this lets us remove or prepend conveyors at the front in amortized constant time,
+	 * without touching the array or the position of the rest of the chain.
+	 */
+	int32 PositionBase = 0;
+
+	/** Measured cost of ticking this bucket, used by the factory tick scheduler */
+	FFactoryTickCost TickCost;
+
+	/** If active, the conveyors in this bucket are not ticked individually, the lane owns all the items. */
+	FConveyorLane Lane;
 };
 
 USTRUCT()
@@ -157,26 +248,65 @@ public:
 	*/
 	class AFGBuildableConveyorBase* GetConnectedConveyorBelt( class UFGFactoryConnectionComponent* connection );
 
-	/** Remove the buildable from the subsystem, this is called by the buildable when destroyed. */
+	/** Remove the buildable from the subsystem, this is called by the buildable when destroyed. Broadcasts BuildableRemovedGlobalDelegate. */
 	void RemoveBuildable( class AFGBuildable* buildable );
 
 	/** Remove the conveyor from the subsystem */
 	void RemoveConveyor( AFGBuildableConveyorBase* conveyor );
 
 	/**
-	 *	Remove a conveyor from the bucket it's assigned to
-	 *	If it's the only conveyor in the bucket the bucket will be removed
+	 *	Remove a conveyor from the bucket it's assigned to.
+	 *	Removing from either end shrinks the bucket, removing from the middle splits it with SplitConveyorBucketAt.
+	 *	If it's the only conveyor in the bucket the bucket will be released.
 	 */
 	void RemoveConveyorFromBucket( AFGBuildableConveyorBase* conveyorToRemove );
 
-	/** Rearrange the conveyor buckets after we emptied a bucket */
-	void RearrangeConveyorBuckets( int32 emptiedBucketID );
+	/**
+	 *	Split a bucket by removing the conveyor at index, the conveyors on each side end up in separate buckets.
+	 *	The shorter side is moved to a new bucket so the cost is proportional to the smaller part of the chain, the longer side keeps its positions.
+	 */
+	void SplitConveyorBucketAt( FConveyorBucket* bucket, int32 index );
 
 	/**
-	*	Splits up a conveyor bucket into two buckets
-	*	Empties the current bucket and adds all conveyors again into two buckets
-	*/
-	void RemoveAndSplitConveyorBucket( AFGBuildableConveyorBase* conveyorToRemove );
+	 *	Join two chains through a new conveyor, outputSide is the bucket whose last conveyor feeds the new conveyor and inputSide the one whose first conveyor is fed by it.
+	 *	Either may be null. The shorter bucket is moved into the longer one, which is prepended or appended to depending on the side.
+	 *	@return the bucket containing the new conveyor.
+	 */
+	FConveyorBucket* JoinConveyorBuckets( FConveyorBucket* outputSide, AFGBuildableConveyorBase* conveyor, FConveyorBucket* inputSide );
+
+	/** Get a free bucket, reuses released bucket ids so the other buckets never need to be re-indexed. */
+	FConveyorBucket* AllocateConveyorBucket();
+
+	/** Release an empty bucket, its id is reused by the next allocation. */
+	void ReleaseConveyorBucket( FConveyorBucket* bucket );
+
+	/**
+	 * Start simulating a bucket as a single lane, moves all items from the conveyors onto the lane.
+	 * Does nothing if the bucket can not be simulated as a lane, e.g. mixed speeds or too few conveyors.
+	 */
+	void BuildConveyorLane( FConveyorBucket* bucket );
+
+	/** Stop simulating a bucket as a lane, moves all items back to the conveyors. Must be called before the bucket is modified. */
+	void DissolveConveyorLane( FConveyorBucket* bucket );
+
+	/**
+	 * Copy the items for this conveyor from the lane to the conveyor, the lane is still the owner of the items.
+	 * Used for significant conveyors so the items can be drawn and interacted with, and when saving.
+	 */
+	void MaterializeConveyorFromLane( AFGBuildableConveyorBase* conveyor );
+
+	/**
+	 * Remove an item from the lane owning the conveyor's items, e.g. when a player picks it up from the belt.
+	 * @param index - Index of the item on the conveyor, mapped to the lane through the conveyor's segment.
+	 * @return true if the item was found on the lane, the conveyor is re-materialized afterwards.
+	 */
+	bool RemoveConveyorItemFromLane( AFGBuildableConveyorBase* conveyor, int32 index, FInventoryItem& out_item );
+
+	/** @return true if the bucket meets the requirements for being simulated as a lane. */
+	bool CanSimulateConveyorBucketAsLane( const FConveyorBucket* bucket ) const;
+
+	/** Leave the analytical mode for any region containing the buildable, e.g. before it is dismantled or interacted with. */
+	void MaterializeSteadyStateRegionFor( class AFGBuildable* buildable );
 
 	/** Returns true if this subsystem has been created on a server instance */
 	bool IsServerSubSystem() const;
@@ -293,6 +423,24 @@ private:
 	/* Tick all factory buildings, conveyors and conveyor attachments */
 	void TickFactoryActors( float dt );
 
+	/** Tick a bucket simulated as a lane, grabs from the input of the last conveyor and pushes to the output of the first. */
+	void TickConveyorLane( FConveyorBucket* bucket, float dt );
+
+	/**
+	 * Find connected groups of buildables far away from all players whose rates have been stable for mSteadyStateDetectionTime and make them analytical.
+	 * Regions that have a player within mAnalyticalFastForwardDistance, or that reached their valid duration, are re-materialized.
+	 */
+	void UpdateSteadyStateRegions();
+
+	/** Capture the steady state of all buildables in the region and stop ticking them. */
+	bool EnterAnalyticalMode( FSteadyStateRegion& region );
+
+	/** Advance the region in closed form to now, write back inventories, production progress and belt contents and resume ticking. */
+	void ExitAnalyticalMode( FSteadyStateRegion& region );
+
+	/** Reschedule the factory tick work if needed, called before TickFactoryActors executes the schedules */
+	void UpdateFactoryTickSchedules( int32 numWorkers );
+
 public:
 	/** Distance used when calculating if a location is near a base */
 	UPROPERTY( EditDefaultsOnly, Category = "Factory" )
@@ -306,9 +454,16 @@ public:
 	UPROPERTY( BlueprintAssignable, Category = "Build", DisplayName = "OnBuildableConstructedGlobal" )
 	FOnBuildableConstructedGlobal BuildableConstructedGlobalDelegate;
 
+	/** Broadcast when a buildable or decor has been removed from the world, e.g. dismantled. */
+	UPROPERTY( BlueprintAssignable, Category = "Build", DisplayName = "OnBuildableRemovedGlobal" )
+	FOnBuildableRemovedGlobal BuildableRemovedGlobalDelegate;
+
 	/** Print all fixed factory tick information */
 	void DumpFixedFactoryTickValues() const;
 
+	/** The profiler recording the factory tick per buildable, bucket and worker. */
+	FORCEINLINE FFactoryTickProfiler& GetFactoryTickProfiler() { return mFactoryTickProfiler; }
+
 	/**
 	 * Used by UFGColoredInstanceMeshProxy to get an instance if it's not already been assigned
 	 */
@@ -332,39 +487,50 @@ private:
 	/** This contains all factory tickable buildings except conveyors and splitter/mergers */
 	TArray< class AFGBuildable* > mFactoryBuildings;
 
-	// Groupings of factory buildings for reduced thread count parallelization
-	TArray < TArray < class AFGBuildable* >> mFactoryBuildingGroups;
-
-	// Track if we need to rebuild the factory buildings groupings
-	bool mFactoryBuildingGroupsDirty;
+	/** Work stealing schedule of the factory buildings, balanced on the measured tick cost of each building */
+	TFactoryTickScheduler< class AFGBuildable* > mFactoryBuildingScheduler;
 
 	/** All conveyor belts that can be executed in parallel sorted into buckets. 
 	*	Each bucket contains a complete section of belts in the order of output to input.
 	*	A bucket can contain a single conveyor belt, a section or a looped section
 	*	An exception exists for belts that connect to buildables with 2 outputs, those are added to a separate buckets
+	*	Indexed by bucket id, released buckets are left as null until reused.
 	*/
 	TArray< FConveyorBucket* > mConveyorBuckets;
 
+	/** Ids of released buckets in mConveyorBuckets */
+	TArray< int32 > mFreeConveyorBucketIDs;
+
+	/** Allow factories that can not make progress to put their factory tick to sleep until woken by an event, sleeping factories are skipped by the schedule */
+	UPROPERTY( config )
+	bool mAllowFactoryTickSleeping;
+
+	/** Simulate conveyor buckets as one continuous lane instead of ticking each conveyor */
+	UPROPERTY( config )
+	bool mSimulateConveyorBucketsAsLanes;
+
+	/** Minimum number of conveyors in a bucket before it is simulated as a lane, short buckets gain nothing from it */
+	UPROPERTY( config )
+	int32 mMinConveyorsForLaneSimulation;
+
 	/** All conveyors that are not safe to execute in parallel
 	*	At the time of writing this is used only for conveyors connecting to buildings with multiple outputs
 	*/
 	TArray< AFGBuildableConveyorBase* > mSerialConveyorGroup;
 
-	// Groupings of conveyor buckets
-	TArray< TArray < FConveyorBucket* > > mConveyorBucketGroups;
-
-	// Track whether or not we need to repopulate our conveyor groups
-	bool mConveyorBucketGroupsDirty;
+	/** Work stealing schedule of the conveyor buckets, balanced on the measured tick cost of each bucket */
+	TFactoryTickScheduler< FConveyorBucket* > mConveyorBucketScheduler;
 
 	/** All conveyor attachments */
 	UPROPERTY()
 	TArray< class AFGBuildableConveyorAttachment* > mConveyorAttachments;
 
-	// Grouping of conveyor attachments for reduced thread count parallelization
-	TArray< TArray < class AFGBuildableConveyorAttachment* >> mConveyorAttachmentGroups;
+	/** Work stealing schedule of the conveyor attachments, balanced on the measured tick cost of each attachment */
+	TFactoryTickScheduler< class AFGBuildableConveyorAttachment* > mConveyorAttachmentScheduler;
 
-	// Track if we need to rebuild the attachments groupings
-	bool mConveyorAttachmentGroupsDirty;
+	/** How many factory ticks a schedule is kept before it is rebuilt from the updated cost estimates, <= 0 only reschedules when buildables are added or removed */
+	UPROPERTY( config )
+	int32 mFactoryTickRescheduleInterval;
 
 	/************************************************************************/
 	/* End variables for parallelization
@@ -444,6 +610,13 @@ private:
 	/** How much time did we not utilize the previous Factory update? */
 	float mFixedTickDebt;
 
+	/** Number of events kept by the factory tick profiler when enabled, older events are overwritten */
+	UPROPERTY( config )
+	int32 mFactoryTickProfilerCapacity;
+
+	/** Sampling profiler for the factory tick, disabled by default. */
+	FFactoryTickProfiler mFactoryTickProfiler;
+
 	/** Maximum number of buildables that we consider their optimization level during the same frame */
 	int32 mMaxConsideredBuildables;
 
@@ -453,6 +626,24 @@ private:
 	/** Distance we disable buildables ticking on */
 	float mDisabledBuildableTickDistance;
 
+	/** Simulate far away factories that have reached a steady state analytically instead of ticking them */
+	UPROPERTY( config )
+	bool mEnableAnalyticalFastForward;
+
+	/** Regions further away than this from all players can become analytical */
+	UPROPERTY( config )
+	float mAnalyticalFastForwardDistance;
+
+	/** How long the rates in a region must be stable before it can become analytical */
+	UPROPERTY( config )
+	float mSteadyStateDetectionTime;
+
+	/** Regions currently simulated analytically */
+	TArray< FSteadyStateRegion > mSteadyStateRegions;
+
+	/** Buildables in an analytical region, these are skipped by the factory tick */
+	TMap< class AFGBuildable*, int32 > mBuildableToSteadyStateRegion;
+
 	/** Information about what distances we change the tick rate on */
 	UPROPERTY( EditDefaultsOnly, Category = "Factory" )
 	TArray< FDistanceBasedTickRate > mDistanceBasedTickRate;
@@ -112,6 +112,10 @@ public:
 	/** Used by the circuits and circuit subsystem to update the circuit this is connected to. */
 	void SetCircuitID( int32 circuitID );
 
+	/** Used by the circuit subsystem to track the connectivity of the components. */
+	FORCEINLINE int32 GetConnectivityNode() const { return mConnectivityNode; }
+	FORCEINLINE void SetConnectivityNode( int32 node ) { mConnectivityNode = node; }
+
 	/** Debug */
 	void DisplayDebug( class UCanvas* canvas, const class FDebugDisplayInfo& debugDisplay, float& YL, float& YPos );
 	FString GetDebugName() const;
@@ -160,4 +164,7 @@ private:
 	 */
 	UPROPERTY( VisibleAnywhere, ReplicatedUsing = OnRep_CircuitIDChanged, Category = "Connection" )
 	int32 mCircuitID;
+
+	/** Node for this component in the circuit subsystem's FCircuitConnectivity, INDEX_NONE if not added. Server only. */
+	int32 mConnectivityNode;
 };
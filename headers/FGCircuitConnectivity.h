@@ -0,0 +1,349 @@
+// Copyright 2016-2020 Coffee Stain Studios. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Connectivity of the circuit connection graph, the nodes are connection components and the edges wires and hidden connections.
+ *
+ * Used to find out if removing a connection splits a circuit without flooding the whole circuit.
+ * A spanning forest is kept over the graph, every edge is either a tree edge or a non-tree edge, and every node has a component label.
+ * Removing a non-tree edge can never split a component so it is done without any search.
+ * Removing a tree edge cuts a tree in pieces. The pieces are walked in lock step over the tree edges only, and when a piece runs out of
+ * nodes first its non-tree edges are scanned for a replacement edge to another piece, like the replacement search in HDT dynamic connectivity.
+ * If one is found it becomes a tree edge, otherwise the piece has split off. The last piece left is never walked to the end,
+ * so the work is bounded by the smaller pieces and their edges, also when the component stays whole.
+ * The HDT edge levels are not kept, so a replacement search is not amortized over later removals.
+ */
+class FCircuitConnectivity
+{
+public:
+	/** Add a node without edges, in a component of its own. @return the node index, stable until removed. */
+	int32 AddNode()
+	{
+		int32 node;
+		if( mFreeNodes.Num() > 0 )
+		{
+			node = mFreeNodes.Pop( false );
+		}
+		else
+		{
+			node = mTreeEdges.AddDefaulted();
+			mNonTreeEdges.AddDefaulted();
+			mComponents.Add( INDEX_NONE );
+			mVisitStamps.Add( 0 );
+		}
+		mTreeEdges[ node ].Reset();
+		mNonTreeEdges[ node ].Reset();
+		mComponents[ node ] = AllocateComponent( 1 );
+		return node;
+	}
+
+	/**
+	 * Remove a node and all its edges.
+	 * The pieces left by the node's tree edges are resolved together, so a node with several wires can split in several components.
+	 * @param out_splitOffs - The nodes of each component that split off, the largest part is left out and keeps the component.
+	 */
+	void RemoveNode( int32 node, TArray< TArray< int32 > >& out_splitOffs )
+	{
+		out_splitOffs.Reset();
+
+		for( int32 other : mNonTreeEdges[ node ] )
+		{
+			mNonTreeEdges[ other ].RemoveSingleSwap( node, false );
+		}
+		mNonTreeEdges[ node ].Reset();
+
+		mRoots.Reset();
+		for( int32 other : mTreeEdges[ node ] )
+		{
+			mTreeEdges[ other ].RemoveSingleSwap( node, false );
+			mRoots.Add( other );
+		}
+		mTreeEdges[ node ].Reset();
+
+		const int32 component = mComponents[ node ];
+		mComponents[ node ] = INDEX_NONE;
+		if( --mComponentSizes[ component ] == 0 )
+		{
+			mFreeComponents.Add( component );
+		}
+		mFreeNodes.Add( node );
+
+		ResolvePieces( component, out_splitOffs );
+	}
+
+	/** Add an edge, multiple edges between the same nodes are allowed, e.g. a wire and a hidden connection. Edges from a node to itself are ignored. */
+	void AddEdge( int32 a, int32 b )
+	{
+		if( a == b )
+		{
+			return;
+		}
+
+		if( mComponents[ a ] == mComponents[ b ] )
+		{
+			mNonTreeEdges[ a ].Add( b );
+			mNonTreeEdges[ b ].Add( a );
+			return;
+		}
+
+		// Joins two trees, relabel the smaller one so a node is relabeled at most log n times.
+		int32 keep = mComponents[ a ];
+		int32 drop = mComponents[ b ];
+		int32 dropNode = b;
+		if( mComponentSizes[ keep ] < mComponentSizes[ drop ] )
+		{
+			Swap( keep, drop );
+			dropNode = a;
+		}
+		RelabelTree( dropNode, keep );
+		mComponentSizes[ keep ] += mComponentSizes[ drop ];
+		mComponentSizes[ drop ] = 0;
+		mFreeComponents.Add( drop );
+
+		mTreeEdges[ a ].Add( b );
+		mTreeEdges[ b ].Add( a );
+	}
+
+	/**
+	 * Remove one edge between a and b.
+	 * @param out_splitOff - If the graph split, the nodes of the smaller side.
+	 * @return true if a and b are no longer connected.
+	 */
+	bool RemoveEdge( int32 a, int32 b, TArray< int32 >& out_splitOff )
+	{
+		out_splitOff.Reset();
+		if( a == b )
+		{
+			return false;
+		}
+
+		// Prefer removing a non-tree copy of the edge, the forest is untouched then.
+		if( mNonTreeEdges[ a ].RemoveSingleSwap( b, false ) > 0 )
+		{
+			mNonTreeEdges[ b ].RemoveSingleSwap( a, false );
+			return false;
+		}
+		if( mTreeEdges[ a ].RemoveSingleSwap( b, false ) == 0 )
+		{
+			return false;
+		}
+		mTreeEdges[ b ].RemoveSingleSwap( a, false );
+
+		mRoots.Reset();
+		mRoots.Add( a );
+		mRoots.Add( b );
+		ResolvePieces( mComponents[ a ], mSplitOffs );
+		if( mSplitOffs.Num() == 0 )
+		{
+			return false;
+		}
+		out_splitOff = MoveTemp( mSplitOffs[ 0 ] );
+		return true;
+	}
+
+	/** @return true if a and b are in the same component, constant time. */
+	FORCEINLINE bool AreConnected( int32 a, int32 b ) const { return mComponents[ a ] == mComponents[ b ]; }
+
+	/** Get all neighbours of a node, one entry per edge. */
+	void GetNeighbours( int32 node, TArray< int32 >& out_neighbours ) const
+	{
+		out_neighbours.Reset( mTreeEdges[ node ].Num() + mNonTreeEdges[ node ].Num() );
+		out_neighbours.Append( mTreeEdges[ node ] );
+		out_neighbours.Append( mNonTreeEdges[ node ] );
+	}
+
+private:
+	/** A piece of a cut tree, walked from its root in ResolvePieces. */
+	struct FPiece
+	{
+		/** Nodes found so far, also the search queue. */
+		TArray< int32 > Nodes;
+		int32 Head = 0;
+		bool IsActive = false;
+		/** Node the replacement edge of this piece leads to, INDEX_NONE if not merged. */
+		int32 ReplacementTarget = INDEX_NONE;
+	};
+
+	int32 AllocateComponent( int32 size )
+	{
+		const int32 component = mFreeComponents.Num() > 0 ? mFreeComponents.Pop( false ) : mComponentSizes.AddUninitialized();
+		mComponentSizes[ component ] = size;
+		return component;
+	}
+
+	/** Set the label of all nodes in the tree of root, the tree must not already have the label. */
+	void RelabelTree( int32 root, int32 component )
+	{
+		mQueue.Reset();
+		mQueue.Add( root );
+		mComponents[ root ] = component;
+		for( int32 head = 0; head < mQueue.Num(); ++head )
+		{
+			for( int32 other : mTreeEdges[ mQueue[ head ] ] )
+			{
+				if( mComponents[ other ] != component )
+				{
+					mComponents[ other ] = component;
+					mQueue.Add( other );
+				}
+			}
+		}
+	}
+
+	/** @return the piece that visited node in the current run, INDEX_NONE if not visited yet. */
+	FORCEINLINE int32 GetVisitingPiece( int32 node ) const
+	{
+		const uint32 piece = mVisitStamps[ node ] - mStampBase;
+		return piece < static_cast< uint32 >( mPieces.Num() ) ? static_cast< int32 >( piece ) : INDEX_NONE;
+	}
+
+	/** Follow the replacement edges from a piece. @return the piece it ends up in, INDEX_NONE if in a part not walked yet. */
+	int32 GetPieceOwner( int32 piece ) const
+	{
+		while( piece != INDEX_NONE && mPieces[ piece ].ReplacementTarget != INDEX_NONE )
+		{
+			piece = GetVisitingPiece( mPieces[ piece ].ReplacementTarget );
+		}
+		return piece;
+	}
+
+	/** Look for a non-tree edge from the piece, or the pieces merged into it, to any other piece. Promotes it to a tree edge if found. */
+	bool FindReplacementEdge( int32 piece )
+	{
+		for( int32 member = 0; member < mPieces.Num(); ++member )
+		{
+			if( GetPieceOwner( member ) != piece )
+			{
+				continue;
+			}
+			for( int32 node : mPieces[ member ].Nodes )
+			{
+				for( int32 other : mNonTreeEdges[ node ] )
+				{
+					if( GetPieceOwner( GetVisitingPiece( other ) ) == piece )
+					{
+						continue;
+					}
+					mNonTreeEdges[ node ].RemoveSingleSwap( other, false );
+					mNonTreeEdges[ other ].RemoveSingleSwap( node, false );
+					mTreeEdges[ node ].Add( other );
+					mTreeEdges[ other ].Add( node );
+					mPieces[ piece ].ReplacementTarget = other;
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	/**
+	 * Resolve the tree pieces hanging off mRoots after tree edges were removed from component.
+	 * The pieces are walked in lock step, each piece that runs out of nodes is either reconnected by a replacement edge or split off.
+	 * Stops when one piece is left, that piece and everything reconnected to it keeps the component.
+	 */
+	void ResolvePieces( int32 component, TArray< TArray< int32 > >& out_splitOffs )
+	{
+		out_splitOffs.Reset();
+		const int32 numPieces = mRoots.Num();
+		if( numPieces < 2 )
+		{
+			return;
+		}
+
+		mStampBase = mStamp + 1;
+		mStamp += numPieces;
+		mPieces.SetNum( numPieces );
+		for( int32 i = 0; i < numPieces; ++i )
+		{
+			FPiece& piece = mPieces[ i ];
+			piece.Nodes.Reset();
+			piece.Nodes.Add( mRoots[ i ] );
+			piece.Head = 0;
+			piece.IsActive = true;
+			piece.ReplacementTarget = INDEX_NONE;
+			mVisitStamps[ mRoots[ i ] ] = mStampBase + i;
+		}
+
+		int32 numActive = numPieces;
+		while( numActive > 1 )
+		{
+			for( int32 i = 0; i < numPieces && numActive > 1; ++i )
+			{
+				FPiece& piece = mPieces[ i ];
+				if( !piece.IsActive )
+				{
+					continue;
+				}
+
+				if( piece.Head < piece.Nodes.Num() )
+				{
+					const int32 node = piece.Nodes[ piece.Head++ ];
+					for( int32 other : mTreeEdges[ node ] )
+					{
+						// Visited nodes are either our own or behind a replacement edge into a piece that is already resolved.
+						if( GetVisitingPiece( other ) == INDEX_NONE )
+						{
+							mVisitStamps[ other ] = mStampBase + i;
+							piece.Nodes.Add( other );
+						}
+					}
+					continue;
+				}
+
+				piece.IsActive = false;
+				--numActive;
+				if( FindReplacementEdge( i ) )
+				{
+					continue;
+				}
+
+				// Split off, collect the piece and everything reconnected to it into a new component.
+				TArray< int32 >& splitOff = out_splitOffs.AddDefaulted_GetRef();
+				for( int32 member = 0; member < numPieces; ++member )
+				{
+					if( GetPieceOwner( member ) == i )
+					{
+						splitOff.Append( mPieces[ member ].Nodes );
+					}
+				}
+				const int32 newComponent = AllocateComponent( splitOff.Num() );
+				mComponentSizes[ component ] -= splitOff.Num();
+				for( int32 node : splitOff )
+				{
+					mComponents[ node ] = newComponent;
+				}
+			}
+		}
+	}
+
+private:
+	/** Tree edges of the spanning forest per node, one entry per edge. */
+	TArray< TArray< int32 > > mTreeEdges;
+
+	/** Edges not in the spanning forest per node, one entry per edge. */
+	TArray< TArray< int32 > > mNonTreeEdges;
+
+	/** Component label per node, equal labels means connected. */
+	TArray< int32 > mComponents;
+
+	/** Number of nodes per component label. */
+	TArray< int32 > mComponentSizes;
+
+	/** Removed nodes and unused component labels to reuse. */
+	TArray< int32 > mFreeNodes;
+	TArray< int32 > mFreeComponents;
+
+	/** Which piece last visited each node, avoids clearing a visited set per search. Pieces of a run use mStampBase and up. */
+	TArray< uint32 > mVisitStamps;
+	uint32 mStamp = 0;
+	uint32 mStampBase = 0;
+
+	/** Scratch kept to avoid allocating. */
+	TArray< FPiece > mPieces;
+	TArray< int32 > mRoots;
+	TArray< int32 > mQueue;
+	TArray< TArray< int32 > > mSplitOffs;
+};
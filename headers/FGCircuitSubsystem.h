@@ -4,6 +4,7 @@
 
 #include "FGSubsystem.h"
 #include "FGSaveInterface.h"
+#include "FGCircuitConnectivity.h"
 #include "FGCircuitSubsystem.generated.h"
 
 
@@ -86,7 +87,7 @@ public:
 	 * @param first - First connection component.
 	 * @param second - Second connection component.
 	 *
-	 * @note Multiple calls to this functions the same frame only triggers one rebuild.
+	 * @note Only the part split off from the circuit, if any, is moved to a new circuit. The rest of the circuit is untouched.
 	 */
 	void DisconnectComponents( class UFGCircuitConnectionComponent* first, class UFGCircuitConnectionComponent* second );
 
@@ -99,6 +100,9 @@ public:
 	 */
 	void RemoveComponent( class UFGCircuitConnectionComponent* component );
 
+	/** Release the power history tiers a player is subscribed to in all circuits. Called from AFGGameMode::Logout. */
+	void RemovePowerHistorySubscriber( class AFGPlayerController* playerController );
+
 protected:
 	/** Called when a power circuit lost power. */
 	UFUNCTION( BlueprintImplementableEvent, Category = "FactoryGame|Circuits|Power" )
@@ -129,9 +133,21 @@ private:
 
 	/** Adds a connection component to a circuit, performs a circuit merge if the component is already connected to another circuit. */
 	void AddComponentToCircuit( class UFGCircuitConnectionComponent* component, int32 circuitID );
-	/** Removes a connection component from it's circuit. If the connection component does not have a valid circuit ID this does nothing. */
+	/**
+	 * Removes a connection component from it's circuit. If the connection component does not have a valid circuit ID this does nothing.
+	 * The component's connectivity node is removed with FCircuitConnectivity::RemoveNode, every part that split off is moved to a circuit of its own.
+	 */
 	void RemoveComponentFromCircuit( class UFGCircuitConnectionComponent* component );
 
+	/** Get the connectivity node for a component, adds one with the component's wires and hidden connections if it has none. */
+	int32 GetOrAddConnectivityNode( class UFGCircuitConnectionComponent* component );
+
+	/**
+	 * Move the components split off from a circuit to a new circuit, the components left in the old circuit are not touched.
+	 * @param splitOffNodes - Connectivity nodes of the split off part, from FCircuitConnectivity::RemoveEdge or one of the parts from RemoveNode.
+	 */
+	void SplitCircuit( int32 circuitID, const TArray< int32 >& splitOffNodes );
+
 private:
 	friend class UFGPowerCircuit;
 
@@ -145,4 +161,16 @@ private:
 
 	/** Counter for generating new circuit ids. */
 	int32 IDCounter;
+
+	/** Connectivity of all connection components, used to detect splits when a connection is removed. Server only. */
+	FCircuitConnectivity mConnectivity;
+
+	/** The component for each connectivity node. */
+	TArray< class UFGCircuitConnectionComponent* > mConnectivityNodeComponents;
+
+	/** Scratch for the split off nodes, kept to avoid allocating. */
+	TArray< int32 > mSplitOffNodes;
+
+	/** Scratch for the parts split off when a component with several connections is removed, each becomes a circuit of its own. */
+	TArray< TArray< int32 > > mSplitOffParts;
 };
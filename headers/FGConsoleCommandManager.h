@@ -63,6 +63,17 @@ public:
 	UFUNCTION( exec )
 	void FixupBuiltByRecipeInOldSave( bool reapplyRecipeIfBetterMatchFound = false );
 
+	/**
+	 * Start or stop the factory tick profiler.
+	 * @param sampleInterval - Record every n:th factory tick.
+	 */
+	UFUNCTION( exec )
+	void FactoryTickProfiler( bool enable, int32 sampleInterval = 1 );
+
+	/** Export the recorded factory tick profile to the Saved/Profiling folder, either as a chrome trace (json) or collapsed stacks for flame graphs. */
+	UFUNCTION( exec )
+	void ExportFactoryTickProfile( const FString& fileName, bool asFlameGraph = false );
+
 	/** Dump some stats about the factory to the log such as number of buildings and kilometers of railway built. */
 	UFUNCTION( exec, CheatBoard, category = "Log" )
 	void DumpFactoryStatsToLog();
@@ -164,6 +164,16 @@ public:
 	UFUNCTION( BlueprintCallable, Category = "FactoryGame|Factory|FactoryConnection" )
 	bool Factory_GrabOutput( FInventoryItem& out_item, float& out_OffsetBeyond, TSubclassOf< UFGItemDescriptor > type = nullptr );
 
+	/**
+	 * Grab up to maxNum items of one class from the output in a single call, e.g. as many as MaxNumGrab allows this tick.
+	 * Same as calling Factory_GrabOutput repeatedly but the source only updates its state once, and an inventory fires its delegates once for the whole batch.
+	 * @param type - Type to grab, nullptr for whatever class is first in the output. All grabbed items are of the same class.
+	 * @param out_items - The grabbed items are appended here.
+	 * @param out_offsetsBeyond - How far beyond the belt each item was, same order as out_items.
+	 * @return the number of items grabbed.
+	 */
+	int32 Factory_GrabOutputBatch( int32 maxNum, TArray< FInventoryItem >& out_items, TArray< float >& out_offsetsBeyond, TSubclassOf< UFGItemDescriptor > type = nullptr );
+
 	/**
 	 * Internal function, for when overloading how to handle a peek, peeks our output from a inventory
 	 */
@@ -176,6 +186,15 @@ public:
 	UFUNCTION( BlueprintCallable, Category = "FactoryGame|Factory|FactoryConnection" )
 	bool Factory_Internal_GrabOutputInventory( FInventoryItem& out_item, TSubclassOf< UFGItemDescriptor > type );
 
+	/** Batch version of Factory_Internal_GrabOutputInventory, removes the items from the inventory in one go. @return the number of items grabbed. */
+	int32 Factory_Internal_GrabOutputInventoryBatch( int32 maxNum, TArray< FInventoryItem >& out_items, TSubclassOf< UFGItemDescriptor > type );
+
+	/**
+	 * Notify whoever is connected to this output that there is something to grab, wakes up the connected buildable if its factory tick is sleeping.
+	 * Called e.g. by conveyors when an item reaches the end of the belt.
+	 */
+	void Factory_NotifyOutputAvailable() const;
+
 	/** Debug */
 	void DisplayDebug( int32 connectionIndex, class UCanvas* canvas, const class FDebugDisplayInfo& debugDisplay, float& YL, float& YPos );
 
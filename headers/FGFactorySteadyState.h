@@ -0,0 +1,205 @@
+// Copyright 2016-2020 Coffee Stain Studios. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ItemAmount.h"
+
+/**
+ * Flow of one item class in or out of a buildable, in items per second.
+ */
+struct FSteadyStateItemRate
+{
+	FSteadyStateItemRate() :
+		ItemClass( nullptr ),
+		ItemsPerSecond( 0.f )
+	{
+	}
+
+	FSteadyStateItemRate( TSubclassOf< class UFGItemDescriptor > itemClass, float itemsPerSecond ) :
+		ItemClass( itemClass ),
+		ItemsPerSecond( itemsPerSecond )
+	{
+	}
+
+	/** Rate for a recipe amount produced or consumed every cycle. */
+	static FSteadyStateItemRate FromCycle( const FItemAmount& amount, float cycleTime )
+	{
+		return FSteadyStateItemRate( amount.ItemClass, cycleTime > SMALL_NUMBER ? amount.Amount / cycleTime : 0.f );
+	}
+
+	TSubclassOf< class UFGItemDescriptor > ItemClass;
+	float ItemsPerSecond;
+};
+
+/**
+ * Steady state of a producing factory, derived from its recipe, cycle time and potential.
+ * While in steady state the factory is not ticked, the number of completed cycles is computed in closed form when fast forwarding.
+ */
+struct FFactorySteadyState
+{
+	/** Time for one production cycle, with the potential applied, i.e. GetProductionCycleTime. */
+	float CycleTime = 0.f;
+
+	/** Production progress [0,1) when entering steady state. */
+	float CycleProgress = 0.f;
+
+	TArray< FSteadyStateItemRate > Inputs;
+	TArray< FSteadyStateItemRate > Outputs;
+
+	FORCEINLINE bool IsValid() const { return CycleTime > SMALL_NUMBER; }
+
+	/**
+	 * Advance the production by dt, updates the progress.
+	 * @return the number of completed cycles.
+	 */
+	int32 Advance( float dt )
+	{
+		const float progress = CycleProgress + dt / CycleTime;
+		const int32 numCycles = FMath::FloorToInt( progress );
+		CycleProgress = progress - numCycles;
+		return numCycles;
+	}
+};
+
+/**
+ * Steady state of a conveyor, the items on the belt are a uniform train moving at a constant speed.
+ * A backed up belt is also a steady state, the items are then stationary and compact.
+ * Used to re-materialize the exact item offsets when leaving the analytical mode.
+ */
+struct FConveyorSteadyState
+{
+	TSubclassOf< class UFGItemDescriptor > ItemClass;
+
+	/** Throughput of the belt, limited by the belt speed and what is put on it. */
+	float ItemsPerSecond = 0.f;
+
+	float Speed = 0.f;
+	float Length = 0.f;
+
+	/** Distance from the input to the rearmost item when entering steady state, in range [0,spacing). */
+	float Phase = 0.f;
+
+	/** If the output is blocked, the belt is then full and nothing moves. */
+	bool IsBackedUp = false;
+
+	/** Distance between the items in the train. */
+	FORCEINLINE float GetSpacing( float minSpacing ) const
+	{
+		if( IsBackedUp || ItemsPerSecond <= SMALL_NUMBER )
+		{
+			return minSpacing;
+		}
+		return FMath::Max( Speed / ItemsPerSecond, minSpacing );
+	}
+
+	/**
+	 * Compute the item offsets after the given time in steady state.
+	 * Offsets are in belt order, index 0 is closest to the output.
+	 * The train repeats every spacing / Speed seconds, so elapsed is reduced by that period in double before it is turned into a distance.
+	 * The tail is then as exact after days in steady state as after a second.
+	 */
+	void Materialize( double elapsed, float minSpacing, TArray< float >& out_offsets ) const
+	{
+		out_offsets.Reset();
+		if( !IsBackedUp && ItemsPerSecond <= SMALL_NUMBER )
+		{
+			return;
+		}
+
+		const float spacing = GetSpacing( minSpacing );
+		float tail = Phase;
+		if( !IsBackedUp && Speed > SMALL_NUMBER )
+		{
+			// FMath::Fmod is float only, reduce with a double floor instead.
+			const double period = static_cast< double >( spacing ) / Speed;
+			const double reducedElapsed = elapsed - period * FMath::FloorToDouble( elapsed / period );
+			const double distance = Phase + Speed * reducedElapsed;
+			tail = static_cast< float >( distance - spacing * FMath::FloorToDouble( distance / spacing ) );
+		}
+		const int32 numItems = FMath::Max( FMath::FloorToInt( ( Length - tail ) / spacing ) + 1, 0 );
+		out_offsets.SetNumUninitialized( numItems );
+		for( int32 i = 0; i < numItems; ++i )
+		{
+			out_offsets[ i ] = tail + ( numItems - 1 - i ) * spacing;
+		}
+	}
+};
+
+/**
+ * Item count of one class in an inventory at the edge of a steady state region, e.g. a storage filled by the region or a source it is drained from.
+ * Changes linearly while in steady state, the region has to leave the steady state when the inventory runs full or empty.
+ */
+struct FSteadyStateInventoryFlow
+{
+	class UFGInventoryComponent* Inventory = nullptr;
+	TSubclassOf< class UFGItemDescriptor > ItemClass;
+
+	/** Items added per second, negative if drained. */
+	float NetItemsPerSecond = 0.f;
+
+	/** Number of items and room for the class when entering steady state. */
+	int32 StartAmount = 0;
+	int32 Capacity = 0;
+
+	FORCEINLINE int32 GetAmountAt( double elapsed ) const
+	{
+		const double amount = StartAmount + FMath::FloorToDouble( NetItemsPerSecond * elapsed );
+		return static_cast< int32 >( FMath::Clamp( amount, 0.0, static_cast< double >( Capacity ) ) );
+	}
+
+	/** Time until this inventory runs full or empty, MAX_flt if never. */
+	FORCEINLINE float GetTimeUntilBound() const
+	{
+		if( NetItemsPerSecond > SMALL_NUMBER )
+		{
+			return ( Capacity - StartAmount ) / NetItemsPerSecond;
+		}
+		if( NetItemsPerSecond < -SMALL_NUMBER )
+		{
+			return StartAmount / -NetItemsPerSecond;
+		}
+		return MAX_flt;
+	}
+};
+
+/**
+ * A connected group of buildables simulated analytically while no player is near it.
+ * The region is entered when all its buildables have had stable rates for a while, and left when a player comes close or the earliest inventory bound is reached.
+ */
+struct FSteadyStateRegion
+{
+	/** All buildables in the region, they are not factory ticked while the region is analytical. */
+	TArray< class AFGBuildable* > Buildables;
+
+	TMap< class AFGBuildableFactory*, FFactorySteadyState > Factories;
+	TMap< class AFGBuildableConveyorBase*, FConveyorSteadyState > Conveyors;
+	TArray< FSteadyStateInventoryFlow > InventoryFlows;
+
+	/** Bounds of the region, used to check the distance to the players. */
+	FBox Bounds = FBox( ForceInit );
+
+	/** World time when the region became analytical, negative if it is simulated normally. */
+	float EnterTime = -1.f;
+
+	/**
+	 * Time spent analytical, accumulated in double every tick.
+	 * Use this rather than the world time minus EnterTime when materializing, a float world time loses the sub tick precision after a few hours.
+	 */
+	double Elapsed = 0.0;
+
+	/** Time in the region when the first inventory flow hits a bound, the region must be re-materialized before that. */
+	float ValidDuration = MAX_flt;
+
+	FORCEINLINE bool IsAnalytical() const { return EnterTime >= 0.f; }
+
+	/** Compute how long the steady state holds from the inventory flows. */
+	void UpdateValidDuration()
+	{
+		ValidDuration = MAX_flt;
+		for( const FSteadyStateInventoryFlow& flow : InventoryFlows )
+		{
+			ValidDuration = FMath::Min( ValidDuration, flow.GetTimeUntilBound() );
+		}
+	}
+};
@@ -0,0 +1,124 @@
+// Copyright 2016-2020 Coffee Stain Studios. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FGFluidIntegrantInterface.h"
+
+/**
+ * Simulation state for all fluid boxes in a pipe network, one contiguous array per value.
+ *
+ * The FFluidBox in the actors is still what is saved and replicated, but while the network is simulated it works on these arrays only.
+ * The boxes are gathered once before the substeps and the results scattered back once after, instead of every junction pass chasing pointers into the actors.
+ * Values that are the same for all passes, like the limits and heights, are only gathered when the update list is rebuilt.
+ *
+ * @note ALL distance units are in meters, same as FFluidBox.
+ */
+struct FFluidBoxArrays
+{
+	FORCEINLINE int32 Num() const { return Boxes.Num(); }
+
+	void Reset()
+	{
+		Boxes.Reset();
+		Z.Reset();
+		LowZ.Reset();
+		HighZ.Reset();
+		Height.Reset();
+		LaminarHeight.Reset();
+		MaxContent.Reset();
+		MaxOverfillPct.Reset();
+		FlowLimit.Reset();
+		Content.Reset();
+		FlowThrough.Reset();
+		FlowFill.Reset();
+		FlowDrain.Reset();
+		FlowDirection.Reset();
+		PressureGroup.Reset();
+		PressureColumn.Reset();
+		ElevationPressureColumn.Reset();
+		AddedPressure.Reset();
+	}
+
+	/** Add a box, called when the update list is rebuilt. @return the index of the box. */
+	int32 Add( FFluidBox* box )
+	{
+		const int32 index = Boxes.Add( box );
+		Z.Add( box->Z );
+		LowZ.Add( box->LowZ );
+		HighZ.Add( box->HighZ );
+		Height.Add( box->Height );
+		LaminarHeight.Add( box->LaminarHeight );
+		MaxContent.Add( box->MaxContent );
+		MaxOverfillPct.Add( box->MaxOverfillPct );
+		FlowLimit.Add( box->FlowLimit );
+		Content.Add( box->Content );
+		FlowThrough.Add( box->FlowThrough );
+		FlowFill.Add( box->FlowFill );
+		FlowDrain.Add( box->FlowDrain );
+		FlowDirection.Add( box->FlowDirection );
+		PressureGroup.Add( box->PressureGroup );
+		PressureColumn.Add( box->PressureColumn );
+		ElevationPressureColumn.Add( box->ElevationPressureColumn );
+		AddedPressure.Add( box->GetCurrentAddedPressure() );
+		return index;
+	}
+
+	/**
+	 * Read the values that can change outside the simulation, i.e. content added or removed by the buildables and the pump settings.
+	 * Called once per tick before the substeps.
+	 */
+	void Gather()
+	{
+		for( int32 i = 0; i < Boxes.Num(); ++i )
+		{
+			const FFluidBox* box = Boxes[ i ];
+			Content[ i ] = box->Content;
+			FlowLimit[ i ] = box->FlowLimit;
+			AddedPressure[ i ] = box->GetCurrentAddedPressure();
+		}
+	}
+
+	/** Write the simulated values back to the boxes, called once per tick after the substeps. */
+	void Scatter() const
+	{
+		for( int32 i = 0; i < Boxes.Num(); ++i )
+		{
+			FFluidBox* box = Boxes[ i ];
+			box->Content = Content[ i ];
+			box->FlowThrough = FlowThrough[ i ];
+			box->FlowFill = FlowFill[ i ];
+			box->FlowDrain = FlowDrain[ i ];
+			box->FlowDirection = FlowDirection[ i ];
+			box->PressureGroup = PressureGroup[ i ];
+			box->PressureColumn = PressureColumn[ i ];
+			box->ElevationPressureColumn = ElevationPressureColumn[ i ];
+		}
+	}
+
+	/** The boxes in the actors, only touched by Gather and Scatter. */
+	TArray< FFluidBox* > Boxes;
+
+	/** Constant while the update list is valid. */
+	TArray< float > Z;
+	TArray< float > LowZ;
+	TArray< float > HighZ;
+	TArray< float > Height;
+	TArray< float > LaminarHeight;
+	TArray< float > MaxContent;
+	TArray< float > MaxOverfillPct;
+
+	/** Gathered every tick. */
+	TArray< float > FlowLimit;
+	TArray< float > AddedPressure;
+
+	/** Simulated. */
+	TArray< float > Content;
+	TArray< float > FlowThrough;
+	TArray< float > FlowFill;
+	TArray< float > FlowDrain;
+	TArray< float > FlowDirection;
+	TArray< int32 > PressureGroup;
+	TArray< float > PressureColumn;
+	TArray< float > ElevationPressureColumn;
+};
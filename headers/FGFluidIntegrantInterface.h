@@ -91,16 +91,11 @@ public:
 	/** Toggle to allow disabling added pressure ( currently used by pumps ) */
 	float AddedPressureToggle = 1.f;
 
-	//@todo-Pipes WITH_EDITORONLY_DATA maybe
-	bool Debug_EnableVerboseLogging = false;
-	int32 Debug_PressureGroup = INDEX_NONE;
-	float Debug_DP = 0.f;
-	float Debug_SmoothedFlow = 0.f;
-	float Debug_FlowLimit = 0.f;
-	float Debug_MoveLimit = 0.f;
+	/** Index of this box in the owning network's FFluidBoxArrays, INDEX_NONE if not simulated. Not saved, assigned when the network rebuilds its update list. */
+	int32 SimulationIndex = INDEX_NONE;
 
-	/** Call to get the current added pressure taking into account the pressure toggle. */
-	float GetCurrentAddedPressure()
+	/** Call to get the current added pressure taking into account the pressure toggle. Also what the simulation gathers, see FFluidBoxArrays. */
+	FORCEINLINE float GetCurrentAddedPressure() const
 	{
 		return AddedPressure * AddedPressureToggle;
 	}
@@ -141,9 +136,21 @@ public:
 		PressureGroup = INDEX_NONE;
 		PressureColumn = 0.f;
 
+#if !UE_BUILD_SHIPPING
 		Debug_PressureGroup = INDEX_NONE;
 		Debug_DP = 0.f;
+#endif
 	}
+
+#if !UE_BUILD_SHIPPING
+	/** Debug values for the pipe debug display, last in the struct and compiled out of shipping builds so they stay out of the simulated layout. */
+	bool Debug_EnableVerboseLogging = false;
+	int32 Debug_PressureGroup = INDEX_NONE;
+	float Debug_DP = 0.f;
+	float Debug_SmoothedFlow = 0.f;
+	float Debug_FlowLimit = 0.f;
+	float Debug_MoveLimit = 0.f;
+#endif
 };
 
 template<>
@@ -0,0 +1,323 @@
+// Copyright 2016-2020 Coffee Stain Studios. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/VectorRegister.h"
+#include "Async/ParallelFor.h"
+#include "Containers/BitArray.h"
+
+/**
+ * Single channel fog of war reveal buffer split into square tiles.
+ * Each tile has a dirty flag for the texture upload and one for the network sync, so only the changed tiles are uploaded and sent.
+ * The buffer is row major, tiles are only used for the change tracking and for the transfer.
+ */
+struct FFogOfWarTiles
+{
+	static constexpr int32 TILE_SIZE = 32;
+
+	/** A circle to reveal, in pixels. */
+	struct FRevealCircle
+	{
+		FVector2D Center;
+		float Radius;
+
+		/** Value in the center, [0,255]. */
+		float MaxValue;
+
+		/** How fast the value reaches MaxValue from the edge, 1 is a linear gradient all the way to the center. */
+		float GradientExpand;
+	};
+
+	void Init( int32 resolution )
+	{
+		Resolution = resolution;
+		NumTilesPerSide = FMath::DivideAndRoundUp( resolution, TILE_SIZE );
+		Pixels.SetNumZeroed( resolution * resolution );
+		TextureDirty.SetNumZeroed( NumTilesPerSide * NumTilesPerSide );
+		NetDirty.SetNumZeroed( NumTilesPerSide * NumTilesPerSide );
+	}
+
+	FORCEINLINE int32 GetResolution() const { return Resolution; }
+	FORCEINLINE int32 GetNumTilesPerSide() const { return NumTilesPerSide; }
+	FORCEINLINE int32 GetNumTiles() const { return TextureDirty.Num(); }
+	FORCEINLINE uint8 GetPixel( int32 x, int32 y ) const { return Pixels[ y * Resolution + x ]; }
+
+	/** Get the pixel rectangle covered by a tile, clipped to the buffer. */
+	FORCEINLINE FIntRect GetTileRect( int32 tileIndex ) const
+	{
+		const FIntPoint min( ( tileIndex % NumTilesPerSide ) * TILE_SIZE, ( tileIndex / NumTilesPerSide ) * TILE_SIZE );
+		return FIntRect( min, FIntPoint( FMath::Min( min.X + TILE_SIZE, Resolution ), FMath::Min( min.Y + TILE_SIZE, Resolution ) ) );
+	}
+
+	/** Copy the pixels from one channel of an interleaved buffer, e.g. when loading a save. Marks everything dirty. */
+	void ReadChannel( const TArray< uint8 >& interleaved, int32 numChannels, int32 channel )
+	{
+		for( int32 i = 0; i < Pixels.Num(); ++i )
+		{
+			Pixels[ i ] = interleaved[ i * numChannels + channel ];
+		}
+		FMemory::Memset( TextureDirty.GetData(), 1, TextureDirty.Num() );
+	}
+
+	/** Copy the pixels of a tile into one channel of an interleaved buffer, e.g. the texture data. */
+	void WriteTileToChannel( int32 tileIndex, TArray< uint8 >& interleaved, int32 numChannels, int32 channel ) const
+	{
+		const FIntRect rect = GetTileRect( tileIndex );
+		for( int32 y = rect.Min.Y; y < rect.Max.Y; ++y )
+		{
+			for( int32 x = rect.Min.X; x < rect.Max.X; ++x )
+			{
+				interleaved[ ( y * Resolution + x ) * numChannels + channel ] = Pixels[ y * Resolution + x ];
+			}
+		}
+	}
+
+	/**
+	 * Reveal the circles, the pixel value is only ever increased.
+	 * Rows of tiles are rasterized in parallel, each worker owns its tile row so no synchronization is needed.
+	 */
+	void RevealCircles( const TArray< FRevealCircle >& circles, bool forceSingleThread )
+	{
+		if( circles.Num() == 0 )
+		{
+			return;
+		}
+
+		ParallelFor( NumTilesPerSide, [ & ]( int32 tileRow )
+		{
+			const int32 rowMin = tileRow * TILE_SIZE;
+			const int32 rowMax = FMath::Min( rowMin + TILE_SIZE, Resolution ) - 1;
+			for( const FRevealCircle& circle : circles )
+			{
+				const int32 yMin = FMath::Max( FMath::FloorToInt( circle.Center.Y - circle.Radius ), rowMin );
+				const int32 yMax = FMath::Min( FMath::CeilToInt( circle.Center.Y + circle.Radius ), rowMax );
+				for( int32 y = yMin; y <= yMax; ++y )
+				{
+					RevealSpan( circle, y, tileRow );
+				}
+			}
+		}, forceSingleThread );
+	}
+
+	/** Get and clear the tiles changed since the last call. */
+	void ConsumeTextureDirtyTiles( TArray< int32 >& out_tiles ) { ConsumeDirty( TextureDirty, out_tiles ); }
+
+	/** Add the tiles changed since the last call to a client's pending tiles, and clear the net dirty flags. A tile is only pending once no matter how often it changes. */
+	void ConsumeNetDirtyTiles( const TArray< TBitArray<>* >& pendingTilesPerClient )
+	{
+		for( int32 i = 0; i < NetDirty.Num(); ++i )
+		{
+			if( NetDirty[ i ] )
+			{
+				for( TBitArray<>* pendingTiles : pendingTilesPerClient )
+				{
+					( *pendingTiles )[ i ] = true;
+				}
+				NetDirty[ i ] = 0;
+			}
+		}
+	}
+
+	/** Init a new client's pending tiles with all tiles that have anything revealed, the only tiles that need to be sent to it. */
+	void GetRevealedTiles( TBitArray<>& out_pendingTiles ) const
+	{
+		out_pendingTiles.Init( false, GetNumTiles() );
+		for( int32 tileIndex = 0; tileIndex < GetNumTiles(); ++tileIndex )
+		{
+			const FIntRect rect = GetTileRect( tileIndex );
+			bool isRevealed = false;
+			for( int32 y = rect.Min.Y; y < rect.Max.Y && !isRevealed; ++y )
+			{
+				for( int32 x = rect.Min.X; x < rect.Max.X && !isRevealed; ++x )
+				{
+					isRevealed = Pixels[ y * Resolution + x ] != 0;
+				}
+			}
+			out_pendingTiles[ tileIndex ] = isRevealed;
+		}
+	}
+
+	/** Largest encoded tile, the index and a run per pixel. */
+	static constexpr int32 MAX_TILE_BYTES = 2 + 2 * TILE_SIZE * TILE_SIZE;
+
+	/**
+	 * Write the pending tiles for the network and clear them, stops before a tile would make the data exceed maxBytes.
+	 * Each tile is its index as uint16 followed by run length encoded ( count, value ) pairs, fog is mostly uniform so a tile is usually a few bytes.
+	 * The current pixels are written, so a tile that changed several times since it was queued is still sent once.
+	 * @param maxBytes - Byte budget, raised to MAX_TILE_BYTES if less so any tile can be sent.
+	 * @return number of tiles written, 0 if there are too many tiles for the uint16 index.
+	 */
+	int32 SerializeTiles( TBitArray<>& pendingTiles, int32 maxBytes, TArray< uint8 >& out_data ) const
+	{
+		out_data.Reset();
+		if( !ensureMsgf( GetNumTiles() <= MAX_uint16, TEXT( "Too many fog of war tiles for the uint16 tile index, raise TILE_SIZE" ) ) )
+		{
+			return 0;
+		}
+
+		maxBytes = FMath::Max( maxBytes, MAX_TILE_BYTES );
+		int32 numWritten = 0;
+		for( TBitArray<>::FIterator it( pendingTiles ); it; ++it )
+		{
+			if( !it.GetValue() )
+			{
+				continue;
+			}
+
+			// Encode, and take the tile back out if it does not fit the budget, it stays pending for the next call.
+			const int32 tileStart = out_data.Num();
+			const int32 tileIndex = it.GetIndex();
+			out_data.Add( tileIndex & 0xff );
+			out_data.Add( ( tileIndex >> 8 ) & 0xff );
+
+			const FIntRect rect = GetTileRect( tileIndex );
+			uint8 runValue = GetPixel( rect.Min.X, rect.Min.Y );
+			uint8 runLength = 0;
+			for( int32 y = rect.Min.Y; y < rect.Max.Y; ++y )
+			{
+				for( int32 x = rect.Min.X; x < rect.Max.X; ++x )
+				{
+					const uint8 value = GetPixel( x, y );
+					if( value != runValue || runLength == MAX_uint8 )
+					{
+						out_data.Add( runLength );
+						out_data.Add( runValue );
+						runValue = value;
+						runLength = 0;
+					}
+					++runLength;
+				}
+			}
+			out_data.Add( runLength );
+			out_data.Add( runValue );
+
+			if( out_data.Num() > maxBytes )
+			{
+				out_data.SetNum( tileStart, false );
+				break;
+			}
+			it.GetValue() = false;
+			++numWritten;
+		}
+		return numWritten;
+	}
+
+	/**
+	 * Read tiles written by SerializeTiles, the pixels are replaced.
+	 * @return false if the data is malformed, tiles read before the error are kept.
+	 */
+	bool DeserializeTiles( const TArray< uint8 >& data, TArray< int32 >& out_tiles )
+	{
+		out_tiles.Reset();
+		int32 readPos = 0;
+		while( readPos + 2 <= data.Num() )
+		{
+			const int32 tileIndex = data[ readPos ] | ( data[ readPos + 1 ] << 8 );
+			readPos += 2;
+			if( tileIndex >= GetNumTiles() )
+			{
+				return false;
+			}
+
+			const FIntRect rect = GetTileRect( tileIndex );
+			const int32 width = rect.Width();
+			const int32 numPixels = rect.Area();
+			int32 pixel = 0;
+			while( pixel < numPixels )
+			{
+				if( readPos + 2 > data.Num() )
+				{
+					return false;
+				}
+				const int32 runLength = FMath::Min< int32 >( data[ readPos ], numPixels - pixel );
+				const uint8 runValue = data[ readPos + 1 ];
+				readPos += 2;
+				for( int32 i = 0; i < runLength; ++i, ++pixel )
+				{
+					Pixels[ ( rect.Min.Y + pixel / width ) * Resolution + rect.Min.X + pixel % width ] = runValue;
+				}
+			}
+
+			TextureDirty[ tileIndex ] = 1;
+			out_tiles.Add( tileIndex );
+		}
+		return readPos == data.Num();
+	}
+
+private:
+	/** Reveal one row of a circle, the values are computed four pixels at a time. */
+	void RevealSpan( const FRevealCircle& circle, int32 y, int32 tileRow )
+	{
+		const float dy = y - circle.Center.Y;
+		const float halfWidthSq = FMath::Square( circle.Radius ) - dy * dy;
+		if( halfWidthSq < 0.f )
+		{
+			return;
+		}
+		const float halfWidth = FMath::Sqrt( halfWidthSq );
+		const int32 xMin = FMath::Max( FMath::CeilToInt( circle.Center.X - halfWidth ), 0 );
+		const int32 xMax = FMath::Min( FMath::FloorToInt( circle.Center.X + halfWidth ), Resolution - 1 );
+		if( xMin > xMax )
+		{
+			return;
+		}
+
+		// value = min( ( 1 - distance / radius ) * gradientExpand, 1 ) * maxValue
+		const VectorRegister dySq = VectorSetFloat1( dy * dy );
+		const VectorRegister centerX = VectorSetFloat1( circle.Center.X );
+		const VectorRegister invRadius = VectorSetFloat1( 1.f / FMath::Max( circle.Radius, 1.f ) );
+		const VectorRegister gradientExpand = VectorSetFloat1( circle.GradientExpand );
+		const VectorRegister maxValue = VectorSetFloat1( circle.MaxValue );
+		const VectorRegister laneOffsets = MakeVectorRegister( 0.f, 1.f, 2.f, 3.f );
+
+		uint8* row = Pixels.GetData() + y * Resolution;
+		MS_ALIGN( 16 ) float values[ 4 ] GCC_ALIGN( 16 );
+		for( int32 x = xMin; x <= xMax; x += 4 )
+		{
+			const VectorRegister dx = VectorSubtract( VectorAdd( VectorSetFloat1( static_cast< float >( x ) ), laneOffsets ), centerX );
+			const VectorRegister distanceSq = VectorMax( VectorMultiplyAdd( dx, dx, dySq ), VectorSetFloat1( SMALL_NUMBER ) );
+			const VectorRegister distance = VectorMultiply( distanceSq, VectorReciprocalSqrt( distanceSq ) );
+			const VectorRegister falloff = VectorMultiply( VectorSubtract( VectorOne(), VectorMultiply( distance, invRadius ) ), gradientExpand );
+			const VectorRegister value = VectorMultiply( VectorMin( VectorMax( falloff, VectorZero() ), VectorOne() ), maxValue );
+			VectorStoreAligned( value, values );
+
+			const int32 numLanes = FMath::Min( 4, xMax - x + 1 );
+			for( int32 lane = 0; lane < numLanes; ++lane )
+			{
+				row[ x + lane ] = FMath::Max( row[ x + lane ], static_cast< uint8 >( FMath::Clamp( FMath::RoundToInt( values[ lane ] ), 0, 255 ) ) );
+			}
+		}
+
+		// The worker owns this tile row so the flags can be written without atomics.
+		for( int32 tileX = xMin / TILE_SIZE; tileX <= xMax / TILE_SIZE; ++tileX )
+		{
+			TextureDirty[ tileRow * NumTilesPerSide + tileX ] = 1;
+			NetDirty[ tileRow * NumTilesPerSide + tileX ] = 1;
+		}
+	}
+
+	static void ConsumeDirty( TArray< uint8 >& dirty, TArray< int32 >& out_tiles )
+	{
+		out_tiles.Reset();
+		for( int32 i = 0; i < dirty.Num(); ++i )
+		{
+			if( dirty[ i ] )
+			{
+				out_tiles.Add( i );
+				dirty[ i ] = 0;
+			}
+		}
+	}
+
+private:
+	int32 Resolution = 0;
+	int32 NumTilesPerSide = 0;
+
+	/** Reveal value per pixel, row major. */
+	TArray< uint8 > Pixels;
+
+	/** One flag per tile, a byte each so workers writing flags of different tiles never write to the same memory location. */
+	TArray< uint8 > TextureDirty;
+	TArray< uint8 > NetDirty;
+};
@@ -134,6 +134,7 @@ public:
 	~UFGGameInstance();
 
 	// Begin UGameInstance interface
+	/** Also builds the FItemRegistry, on both server and clients. */
 	virtual void Init() override;
 	virtual bool JoinSession( ULocalPlayer* localPlayer, const FOnlineSessionSearchResult& searchResult ) override;
 	// End UGameInstance interface
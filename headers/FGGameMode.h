@@ -38,6 +38,7 @@ public:
 	virtual AActor* ChoosePlayerStart_Implementation( AController* player ) override;
 	virtual void RestartPlayer( AController* newPlayer ) override;
 	virtual void PostLogin( APlayerController* newPlayer ) override;
+	/** Also releases the player's power history subscriptions, see AFGCircuitSubsystem::RemovePowerHistorySubscriber. */
 	virtual void Logout( AController* exiting ) override;
 	virtual bool FindInactivePlayer( APlayerController* PC ) override;
 	// End AGameModeBase interface
@@ -0,0 +1,178 @@
+// Copyright 2016-2020 Coffee Stain Studios. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/BitArray.h"
+#include "Resources/FGItemDescriptor.h"
+
+/**
+ * Incrementally maintained lookups for an inventory so the common queries don't have to scan all the slots.
+ * - Total number of items per class.
+ * - Which slots are empty.
+ * - Which slots hold a stack of a class that is not full.
+ * - Which slots are restricted, i.e. has an allowed item or an arbitrary slot size. Those can't be assumed to take any item when empty.
+ *
+ * Updated by the inventory component every time a slot changes, see UFGInventoryComponent::OnItemsAdded/OnItemsRemoved.
+ * Inventories rarely hold more than a few classes so the classes are kept in a small array rather than a map.
+ * Classes are identified by their FItemRegistry id, the inventory component converts the class once per call with FItemRegistry::GetID.
+ */
+struct FInventoryClassIndex
+{
+	struct FClassEntry
+	{
+		FItemClassID ItemClassID = INVALID_ITEM_CLASS_ID;
+		int32 NumItems = 0;
+		/** Slots with this class that still have room. */
+		TArray< int32, TInlineAllocator< 4 > > PartialSlots;
+	};
+
+	/** Clear and size for the given number of slots, all slots are empty. */
+	void Reset( int32 numSlots )
+	{
+		Classes.Reset();
+		EmptySlots.Init( true, numSlots );
+		RestrictedSlots.Init( false, numSlots );
+		NumRestrictedSlots = 0;
+	}
+
+	/**
+	 * Update the index after a slot has changed.
+	 * Also call when the slot size changes, with the same old and new content, so the partial slots are kept correct.
+	 * @param oldItemClassID, oldNum - What the slot held before the change.
+	 * @param newItemClassID, newNum - What the slot holds now.
+	 * @param slotSize - Max number of items in the slot for the new class.
+	 */
+	void OnSlotChanged( int32 idx, FItemClassID oldItemClassID, int32 oldNum, FItemClassID newItemClassID, int32 newNum, int32 slotSize )
+	{
+		if( oldNum > 0 )
+		{
+			if( FClassEntry* entry = FindEntry( oldItemClassID ) )
+			{
+				entry->NumItems -= oldNum;
+				entry->PartialSlots.RemoveSingleSwap( idx, false );
+			}
+		}
+
+		EmptySlots[ idx ] = newNum <= 0;
+		if( newNum > 0 )
+		{
+			FClassEntry& entry = FindOrAddEntry( newItemClassID );
+			entry.NumItems += newNum;
+			if( newNum < slotSize )
+			{
+				entry.PartialSlots.Add( idx );
+			}
+		}
+
+		// Drop classes no longer in the inventory so the array stays short.
+		Classes.RemoveAllSwap( []( const FClassEntry& entry ) { return entry.NumItems <= 0; }, false );
+	}
+
+	/** Set when a slot gets or loses an allowed item or an arbitrary slot size. */
+	void SetSlotRestricted( int32 idx, bool isRestricted )
+	{
+		if( RestrictedSlots[ idx ] != isRestricted )
+		{
+			RestrictedSlots[ idx ] = isRestricted;
+			NumRestrictedSlots += isRestricted ? 1 : -1;
+		}
+	}
+
+	FORCEINLINE bool HasRestrictedSlots() const { return NumRestrictedSlots > 0; }
+	FORCEINLINE bool IsSlotRestricted( int32 idx ) const { return RestrictedSlots[ idx ]; }
+
+	/** Total number of items of a class. */
+	FORCEINLINE int32 GetNumItems( FItemClassID itemClassID ) const
+	{
+		const FClassEntry* entry = FindEntry( itemClassID );
+		return entry ? entry->NumItems : 0;
+	}
+
+	/** First empty slot, INDEX_NONE if full. */
+	FORCEINLINE int32 FindEmptyIndex() const
+	{
+		return EmptySlots.Find( true );
+	}
+
+	FORCEINLINE int32 GetNumEmptySlots() const
+	{
+		return EmptySlots.CountSetBits();
+	}
+
+	/**
+	 * Empty slots without restrictions, these take any item the inventory allows.
+	 * The restricted empty slots must be checked one by one against the slot's allowed item and size, see ForEachRestrictedEmptySlot.
+	 */
+	int32 GetNumUnrestrictedEmptySlots() const
+	{
+		if( NumRestrictedSlots == 0 )
+		{
+			return GetNumEmptySlots();
+		}
+		int32 num = 0;
+		for( TConstSetBitIterator<> it( EmptySlots ); it; ++it )
+		{
+			num += RestrictedSlots[ it.GetIndex() ] ? 0 : 1;
+		}
+		return num;
+	}
+
+	template< typename FuncType >
+	void ForEachRestrictedEmptySlot( FuncType func ) const
+	{
+		for( TConstSetBitIterator<> it( RestrictedSlots ); it; ++it )
+		{
+			if( EmptySlots[ it.GetIndex() ] )
+			{
+				func( it.GetIndex() );
+			}
+		}
+	}
+
+	FORCEINLINE bool IsEmpty() const
+	{
+		return Classes.Num() == 0;
+	}
+
+	/** Slots holding a class that can take more items. */
+	FORCEINLINE const TArray< int32, TInlineAllocator< 4 > >* GetPartialSlots( FItemClassID itemClassID ) const
+	{
+		const FClassEntry* entry = FindEntry( itemClassID );
+		return entry ? &entry->PartialSlots : nullptr;
+	}
+
+private:
+	FORCEINLINE const FClassEntry* FindEntry( FItemClassID itemClassID ) const
+	{
+		return Classes.FindByPredicate( [ itemClassID ]( const FClassEntry& entry ) { return entry.ItemClassID == itemClassID; } );
+	}
+
+	FORCEINLINE FClassEntry* FindEntry( FItemClassID itemClassID )
+	{
+		return Classes.FindByPredicate( [ itemClassID ]( const FClassEntry& entry ) { return entry.ItemClassID == itemClassID; } );
+	}
+
+	FClassEntry& FindOrAddEntry( FItemClassID itemClassID )
+	{
+		if( FClassEntry* entry = FindEntry( itemClassID ) )
+		{
+			return *entry;
+		}
+		FClassEntry& entry = Classes.AddDefaulted_GetRef();
+		entry.ItemClassID = itemClassID;
+		return entry;
+	}
+
+private:
+	/** The classes in the inventory. */
+	TArray< FClassEntry, TInlineAllocator< 4 > > Classes;
+
+	/** Bit per slot, set if the slot is empty. */
+	TBitArray<> EmptySlots;
+
+	/** Bit per slot, set if the slot has an allowed item or an arbitrary slot size. */
+	TBitArray<> RestrictedSlots;
+
+	int32 NumRestrictedSlots = 0;
+};
@@ -4,6 +4,7 @@
 #include "FGSaveInterface.h"
 #include "Resources/FGItemDescriptor.h"
 #include "ItemAmount.h"
+#include "FGInventoryClassIndex.h"
 #include "FGInventoryComponent.generated.h"
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams( FInventoryResized, int32, oldSize, int32, newSize );
@@ -291,6 +292,22 @@ public:
 	UFUNCTION( BlueprintCallable, Category = "Inventory" )
 	void RemoveAllFromIndex( int32 idx );
 
+	/**
+	 * Remove up to num items of a class, taken from the fullest slots first.
+	 * All OnItemRemoved delegates for the removal are fired once as one batch.
+	 * @param itemClass - Class to remove, nullptr for the class in the first non empty slot.
+	 * @param out_item - The item removed, items with a state are never batched so only one such item is removed.
+	 * @return the number of items removed.
+	 */
+	int32 RemoveItemsBatch( TSubclassOf< UFGItemDescriptor > itemClass, int32 num, FInventoryItem& out_item );
+
+	/**
+	 * Group the OnItemAdded/OnItemRemoved delegates of several changes, they are accumulated per class and broadcast once in EndItemBatch.
+	 * Batches can be nested, the delegates are broadcast when the outermost batch ends.
+	 */
+	void BeginItemBatch();
+	void EndItemBatch();
+
 	/** Check if the entire inventory is empty. */
 	UFUNCTION( BlueprintPure, Category = "Inventory" )
 	bool IsEmpty() const;
@@ -338,7 +355,10 @@ public:
 	UFUNCTION( BlueprintCallable, Category = "Inventory" )
 	bool HasEnoughSpaceForStacks( const TArray< FInventoryStack >& stacks ) const;
 
-	/** Check if the inventory has enough space to store the given items. */
+	/**
+	 * Check if the inventory has enough space to store the given items.
+	 * Uses the partial and unrestricted empty slots from mClassIndex, the restricted empty slots are checked with IsItemAllowed and GetSlotSize.
+	 */
 	UFUNCTION( BlueprintCallable, Category = "Inventory" )
 	bool HasEnoughSpaceForStack( const FInventoryStack& stack ) const;
 
@@ -381,11 +401,11 @@ public:
 	UPROPERTY( BlueprintAssignable, Category = "Inventory", DisplayName = "OnItemRemoved" )
 	FOnItemRemoved OnItemRemovedDelegate;
 
-	/** Adds or replaces a arbitrary size for a slot. */
+	/** Adds or replaces a arbitrary size for a slot. Updates the slot in the class index with UpdateClassIndexSlotSize. */
 	UFUNCTION( BlueprintCallable, Category = "Slot Size" )
 	void AddArbitrarySlotSize( int32 index, int32 arbitrarySlotSize );
 
-	/** Removes an Arbitrary size for a slot. */
+	/** Removes an Arbitrary size for a slot. Updates the slot in the class index with UpdateClassIndexSlotSize. */
 	UFUNCTION( BlueprintCallable, Category = "Slot Size" )
 	void RemoveArbitrarySlotSize( int32 index );
 
@@ -466,6 +486,21 @@ protected:
 private:
 	void UpdateRadioactivity( int32 idx, TSubclassOf<UFGItemDescriptor> itemClass );
 
+	/**
+	 * Update mClassIndex for a slot, called wherever a slot changes, i.e. from OnItemsAdded/OnItemsRemoved and when the stacks are replaced by loading, resizing or replication.
+	 * @param oldItemClass, oldNum - What the slot held before the change. The classes are converted to FItemRegistry ids for the index here.
+	 */
+	void UpdateClassIndex( int32 idx, TSubclassOf< UFGItemDescriptor > oldItemClass, int32 oldNum );
+
+	/**
+	 * Update the partial slot and restricted state of a slot in mClassIndex after its size or allowed item changed.
+	 * Called from AddArbitrarySlotSize, RemoveArbitrarySlotSize and SetAllowedItemOnIndex.
+	 */
+	void UpdateClassIndexSlotSize( int32 idx );
+
+	/** Rebuild mClassIndex from all slots, including which slots are restricted. */
+	void RebuildClassIndex();
+
 public:
 	/** Set this to filter out what items are allowed and not allowed in the inventory */
 	FItemFilter mItemFilter;
@@ -490,6 +525,19 @@ private:
 	UPROPERTY( SaveGame, ReplicatedUsing = OnRep_InventoryStacks )
 	TArray< FInventoryStack > mInventoryStacks;
 
+	/**
+	 * Per class totals, empty slots and partially filled slots of mInventoryStacks.
+	 * Makes GetNumItems, HasItems, FindEmptyIndex and IsEmpty constant time, and HasEnoughSpaceForStack only look at the slots that can take the item.
+	 */
+	FInventoryClassIndex mClassIndex;
+
+	/** Nesting depth of BeginItemBatch, delegates are deferred while > 0. */
+	int32 mItemBatchDepth;
+
+	/** Items added and removed per class during the current batch. */
+	TArray< FItemAmount > mBatchedItemsAdded;
+	TArray< FItemAmount > mBatchedItemsRemoved;
+
 	/** Stored last frames data in PreNetReceive, so that we can derive what has happened since last inventory state we received */
 	TArray< FInventoryStack > mClientLastFrameStacks;
 
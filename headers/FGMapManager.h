@@ -6,6 +6,7 @@
 #include "FGSaveInterface.h"
 #include "FGActorRepresentationInterface.h"
 #include "FGMinimapCaptureActor.h"
+#include "FGFogOfWarTiles.h"
 #include "FGMapManager.generated.h"
 
 DECLARE_STATS_GROUP( TEXT( "MapManager" ), STATGROUP_MapManager, STATCAT_Advanced );
@@ -17,15 +18,15 @@ struct FFogOfWarQueuePair
 	GENERATED_BODY()
 
 	FFogOfWarQueuePair() :
-		playerController( nullptr ),
-		currentPackageIndex( 0 )
+		playerController( nullptr )
 	{
 	}
 
 	UPROPERTY()
 	class AFGPlayerController* playerController;
 
-	int32 currentPackageIndex;
+	/** Bit per tile left to send to this client, the revealed tiles on join and the tiles changed since. Bounded by the number of tiles. */
+	TBitArray<> pendingTiles;
 };
 
 /**
@@ -68,11 +69,11 @@ public:
 	/** Puts a player controller in the transfer queue awaiting fog of war transfer  */
 	void RequestFogOfWarData( class AFGPlayerController* playerController );
 
-	/** Transfers fog of war data via player controller  */
+	/** Transfers fog of war data via player controller, at most mFogOfWarBytesPerPacket per client and call  */
 	void TransferFogOfWarData();
 
-	/** Receive fog of war data via player controller  */
-	void SyncFogOfWarChanges( const TArray<uint8>& fogOfWarRawData, int32 index );
+	/** Receive fog of war tiles via player controller, see FFogOfWarTiles::SerializeTiles  */
+	void SyncFogOfWarChanges( const TArray<uint8>& fogOfWarTiles );
 
 private:
 	
@@ -82,11 +83,19 @@ private:
 	void SetupRepresentationManager();
 	void BindActorRepresentationManager( class AFGActorRepresentationManager* representationManager );
 
-	/** Local updates of the fog of war*/
+	/** Local updates of the fog of war, queues a reveal circle that is rasterized in FlushFogOfWarReveals */
 	void UpdateFogOfWar( UFGActorRepresentation* actor );
 	FVector2D GetMapPositionFromWorldLocation( FVector worldLocation );
 	float GetMapDistanceFromWorldDistance( float worldDistance );
-	void DrawCircle( FVector2D centerPoint, float radius, float gradientHeightModifier );
+
+	/** Rasterize all queued reveal circles in one parallel pass */
+	void FlushFogOfWarReveals();
+
+	/** Copy the changed tiles to the raw data and upload only those regions of the texture */
+	void UpdateFogOfWarTexture();
+
+	/** Server only, mark the tiles changed since last call as pending for all clients in the queue */
+	void QueueFogOfWarChangesForClients();
 
 	UFUNCTION()
 	void OnActorRepresentationAdded( class UFGActorRepresentation* actorRepresentation );
@@ -105,15 +114,15 @@ private:
 	int32 mFogOfWarDataSize;
 	/** The resolution for the fog of war texture */
 	int32 mFogOfWarResolution;
-	/** Number of pixels we will send per packet when we transfer fog of war to clients */
-	int32 mFogOfWarPixelsPerPacket;
-	/** Number of packets that will be sent when we transfer fog of war to clients */
-	int32 mFogOfWarNumberOfPackets;
+	/** The reveal channel of mFogOfWarRawData split in tiles, this is what is revealed into and synced. mFogOfWarRawData is updated from the dirty tiles */
+	FFogOfWarTiles mFogOfWarTiles;
+	/** Reveal circles queued since last flush */
+	TArray< FFogOfWarTiles::FRevealCircle > mPendingRevealCircles;
+	/** Max number of bytes we will send per packet when we transfer fog of war tiles to clients */
+	int32 mFogOfWarBytesPerPacket;
 	/** The fog of war texture that is used for the map */
 	UPROPERTY()
 	UTexture2D* mFogOfWarTexture;
-	/** The fog of war texture region used for updating the texture */
-	FUpdateTextureRegion2D mFogOfWarUpdateTextureRegion;
 	/** Capture actor used for translate world locations to map locations  */
 	UPROPERTY()
 	AFGMinimapCaptureActor* mCachedMinimapCaptureActor;
@@ -128,7 +137,7 @@ private:
 	bool mEnableFogOfWarTextureUpdates;
 	bool mForceSingleThreadedCalculations;
 
-	/** Queue to handle clients waiting for fog of war transfer */
+	/** Queue to handle clients waiting for fog of war transfer, clients stay in the queue to receive the changed tiles */
 	UPROPERTY()
 	TArray<FFogOfWarQueuePair> mFogOfWarTransferQueue;
 
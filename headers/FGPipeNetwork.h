@@ -7,6 +7,8 @@
 #include "FGItemDescriptor.h"
 #include "FGSaveInterface.h"
 #include "FGFluidIntegrantInterface.h"
+#include "FGFluidBoxArrays.h"
+#include "FGPipePressureSolver.h"
 #include "FGPipeNetwork.generated.h"
 
 // Draw text or boxes debug mode.
@@ -21,6 +23,14 @@ enum class EDebugPipeVisualization
 	DPV_MoveToOverfillRatio
 };
 
+/** How the pressures in a network are computed. */
+UENUM( BlueprintType )
+enum class EPipeNetworkSolver : uint8
+{
+	PNS_Propagation		UMETA( DisplayName = "Propagation" ),	// Propagate the pressure junction by junction, may need many substeps to settle on long networks.
+	PNS_LinearSolve		UMETA( DisplayName = "Linear Solve" )	// Solve all pressures at once with FPipePressureSolver.
+};
+
 /**
  * Contains all info needed to update a fluid box.
  */
@@ -31,10 +41,15 @@ struct PipeJunction
 	/**
 	 * The fluid boxes on each side of the junction.
 	 * CurrentBox is always valid while PreviousBox might be null at the pipe ends.
+	 * Only used to build the box arrays, the simulation uses the indices.
 	 */
 	struct FFluidBox* PreviousBox = nullptr;
 	struct FFluidBox* CurrentBox = nullptr;
 
+	/** Index of the boxes in the network's FFluidBoxArrays, PreviousBoxIndex is INDEX_NONE where PreviousBox is null. */
+	int32 PreviousBoxIndex = INDEX_NONE;
+	int32 CurrentBoxIndex = INDEX_NONE;
+
 	// The Z height where the outflow is located in relation between the previous and current pipe. [meters]
 	float PreviousOutflowZ = 0.f;
 	float CurrentOutflowZ = 0.f;
@@ -55,7 +70,13 @@ struct PipeJunction
 	 */
 	float Flow = 0.f;
 	float MovedContent = 0.f;
+};
 
+/**
+ * Debug info for a junction, kept in a separate list parallel to the update list so the strings are not in the way when simulating.
+ */
+struct PipeJunctionDebug
+{
 	//@todo-Pipes WITH_EDITORONLY_DATA
 	FVector Debug_Location;
 	FString Debug_Name;
@@ -89,9 +110,24 @@ public:
 	/** Should the subsystem tick this network? */
 	bool ShouldTickNetwork() const;
 	
-	/** Run the simulation on the networks junctions and fluid boxes */
+	/**
+	 * Run the simulation on the networks junctions and fluid boxes.
+	 * Only touches the junctions and fluid boxes of this network, so different networks can be updated in parallel.
+	 */
 	void UpdateSimulation( float dt );
 
+	/** Called on the game thread after all networks have been updated, applies what the update needs to do outside this network, e.g. notifying the integrants. */
+	void PostUpdateSimulation();
+
+	/** Number of junctions to simulate, used to balance the networks over the workers. */
+	FORCEINLINE int32 GetNumJunctions() const { return mUpdateList.Num(); }
+
+	/** The simulation state of the boxes, index with FFluidBox::SimulationIndex. The values in the FFluidBox are only updated once per tick. */
+	FORCEINLINE const FFluidBoxArrays& GetFluidBoxArrays() const { return mFluidBoxes; }
+
+	/** Current content of a box by its simulation index. [m^3] */
+	FORCEINLINE float GetFluidBoxContent( int32 boxIndex ) const { return mFluidBoxes.Content[ boxIndex ]; }
+
 	/** Get the id for this network. */
 	int32 GetPipeNetworkID() const;
 	void SetPipeNetworkID( int32 id );
@@ -127,7 +163,11 @@ public:
 	 */
 	void FlushNetwork();
 
-	/** Manage rebuilding networks. */
+	/** Select how the pressures are computed in this network, switching rebuilds the pressure system. */
+	void SetPressureSolver( EPipeNetworkSolver solver );
+	FORCEINLINE EPipeNetworkSolver GetPressureSolver() const { return mPressureSolverMode; }
+
+	/** Manage rebuilding networks. Also invalidates the pressure system. */
 	void MarkForFullRebuild();
 	bool NeedFullRebuild() const;
 
@@ -148,8 +188,15 @@ private:
 		float HighestElevationZ = -1000000.f;
 	};
 
+	/** Rebuild the junctions and the box arrays. Also invalidates the pressure system. */
 	void RebuildUpdateList();
 
+	/** Build the matrix for the linear pressure solve from the update list, only done when the topology changed. */
+	void RebuildPressureSystem();
+
+	/** Solve the pressures for all boxes with the linear solver, replaces the pressure group and propagation passes. */
+	void SolvePressures( float dt );
+
 	void UpdateFluidDescriptor( TSubclassOf< UFGItemDescriptor > descriptor );
 
 	int32 CreatePressureGroup();
@@ -162,6 +209,13 @@ private:
 	void UpdateFlow( PipeJunction& junction, float dt );
 	void UpdateContent( PipeJunction& junction, float dt );
 
+	/** Per box passes, straight sweeps over mFluidBoxes. */
+	void ResetBoxFlows();
+	void UpdateBoxFlowFeedback( float dt );
+
+	/** Add the boxes of a junction to mFluidBoxes and assign the indices, called from RebuildUpdateList. */
+	void AddJunctionBoxes( PipeJunction& junction );
+
 private:
 	friend class UFGCheatManager;
 
@@ -206,6 +260,12 @@ private:
 	 */
 	TArray< PipeJunction > mUpdateList;
 
+	/** Debug info for the junctions, same order as mUpdateList. */
+	TArray< PipeJunctionDebug > mUpdateListDebug;
+
+	/** State of all boxes referenced from mUpdateList, rebuilt with the update list. */
+	FFluidBoxArrays mFluidBoxes;
+
 	/** If the update list is not up to date */
 	bool mRebuildUpdateList;
 	/** Does this pipe line needs a full rebuild. */
@@ -218,4 +278,20 @@ private:
 	 * See comments in implementation for details.
 	 */
 	TArray< FPressureGroup > mPressureGroups;
+
+	/** How pressures are computed in this network. */
+	UPROPERTY( SaveGame )
+	EPipeNetworkSolver mPressureSolverMode;
+
+	/** The matrix for PNS_LinearSolve, and if it needs to be rebuilt before the next solve. */
+	FPipePressureSolver mPressureSolver;
+	bool mRebuildPressureSystem;
+
+	/** Sources and last solution per box, the solution warm starts the next solve so usually only a few iterations are needed. [meters] */
+	TArray< float > mPressureSources;
+	TArray< float > mSolvedPressures;
+
+	/** Iteration limit and relative residual to stop at for the linear solve. Constant as the networks are solved in parallel. */
+	static constexpr int32 PRESSURE_SOLVE_MAX_ITERATIONS = 64;
+	static constexpr float PRESSURE_SOLVE_TOLERANCE = 1.e-4f;
 };
@@ -0,0 +1,192 @@
+// Copyright 2016-2020 Coffee Stain Studios. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Solves the pressures of a pipe network in one go, as an alternative to propagating the pressure one junction at a time.
+ *
+ * The network is a graph where the fluid boxes are the nodes and the junctions the edges. The system solved is
+ *   ( L + C ) p = b
+ * where L is the graph Laplacian weighted by the conductance of each junction, C a diagonal with the compliance of each box and b the pressure sources.
+ * The compliance keeps the system positive definite, an unconnected box settles on its own pressure.
+ *
+ * The matrix is only built when the topology changes, each tick only does a few conjugate gradient iterations warm started from the previous pressures.
+ */
+struct FPipePressureSolver
+{
+	FORCEINLINE bool IsBuilt() const { return RowStart.Num() > 0; }
+	FORCEINLINE int32 Num() const { return FMath::Max( RowStart.Num() - 1, 0 ); }
+
+	void Reset()
+	{
+		RowStart.Reset();
+		Columns.Reset();
+		Values.Reset();
+		InvDiagonal.Reset();
+	}
+
+	/**
+	 * Build the matrix in compressed sparse row form.
+	 * @param edgesA, edgesB - The boxes on each side of the junctions, same length.
+	 * @param conductance - Conductance per junction, > 0.
+	 * @param compliance - Compliance per box, > 0.
+	 */
+	void Build( const TArray< int32 >& edgesA, const TArray< int32 >& edgesB, const TArray< float >& conductance, const TArray< float >& compliance )
+	{
+		Reset();
+		const int32 numNodes = compliance.Num();
+
+		// Count the entries per row, the diagonal and one per edge end.
+		TArray< int32 > rowCount;
+		rowCount.Init( 1, numNodes );
+		for( int32 e = 0; e < edgesA.Num(); ++e )
+		{
+			++rowCount[ edgesA[ e ] ];
+			++rowCount[ edgesB[ e ] ];
+		}
+
+		RowStart.SetNumUninitialized( numNodes + 1 );
+		RowStart[ 0 ] = 0;
+		for( int32 i = 0; i < numNodes; ++i )
+		{
+			RowStart[ i + 1 ] = RowStart[ i ] + rowCount[ i ];
+		}
+		Columns.SetNumUninitialized( RowStart[ numNodes ] );
+		Values.SetNumZeroed( RowStart[ numNodes ] );
+
+		// The diagonal is the first entry in each row.
+		TArray< int32 > writePos;
+		writePos.SetNumUninitialized( numNodes );
+		for( int32 i = 0; i < numNodes; ++i )
+		{
+			Columns[ RowStart[ i ] ] = i;
+			Values[ RowStart[ i ] ] = compliance[ i ];
+			writePos[ i ] = RowStart[ i ] + 1;
+		}
+
+		for( int32 e = 0; e < edgesA.Num(); ++e )
+		{
+			const int32 a = edgesA[ e ];
+			const int32 b = edgesB[ e ];
+			const float g = conductance[ e ];
+			Values[ RowStart[ a ] ] += g;
+			Values[ RowStart[ b ] ] += g;
+			Columns[ writePos[ a ] ] = b;
+			Values[ writePos[ a ]++ ] = -g;
+			Columns[ writePos[ b ] ] = a;
+			Values[ writePos[ b ]++ ] = -g;
+		}
+
+		// Jacobi preconditioner
+		InvDiagonal.SetNumUninitialized( numNodes );
+		for( int32 i = 0; i < numNodes; ++i )
+		{
+			InvDiagonal[ i ] = 1.f / Values[ RowStart[ i ] ];
+		}
+	}
+
+	/**
+	 * Run the preconditioned conjugate gradient.
+	 * @param rhs - The pressure sources, b.
+	 * @param inout_pressure - The start guess, usually last tick's result, and the result.
+	 * @return the number of iterations done.
+	 */
+	int32 Solve( const TArray< float >& rhs, TArray< float >& inout_pressure, int32 maxIterations, float tolerance )
+	{
+		const int32 num = Num();
+		check( rhs.Num() == num );
+		if( inout_pressure.Num() != num )
+		{
+			inout_pressure.SetNumZeroed( num );
+		}
+		R.SetNumUninitialized( num );
+		Z.SetNumUninitialized( num );
+		P.SetNumUninitialized( num );
+		AP.SetNumUninitialized( num );
+
+		// r = b - A x
+		Multiply( inout_pressure, AP );
+		float bb = 0.f;
+		for( int32 i = 0; i < num; ++i )
+		{
+			R[ i ] = rhs[ i ] - AP[ i ];
+			Z[ i ] = InvDiagonal[ i ] * R[ i ];
+			P[ i ] = Z[ i ];
+			bb += rhs[ i ] * rhs[ i ];
+		}
+		float rz = Dot( R, Z );
+		const float toleranceSq = FMath::Square( tolerance ) * FMath::Max( bb, SMALL_NUMBER );
+
+		int32 iteration = 0;
+		for( ; iteration < maxIterations; ++iteration )
+		{
+			if( Dot( R, R ) <= toleranceSq )
+			{
+				break;
+			}
+
+			Multiply( P, AP );
+			const float pAp = Dot( P, AP );
+			if( pAp <= SMALL_NUMBER )
+			{
+				break;
+			}
+
+			const float alpha = rz / pAp;
+			for( int32 i = 0; i < num; ++i )
+			{
+				inout_pressure[ i ] += alpha * P[ i ];
+				R[ i ] -= alpha * AP[ i ];
+				Z[ i ] = InvDiagonal[ i ] * R[ i ];
+			}
+
+			const float rzNew = Dot( R, Z );
+			const float beta = rzNew / rz;
+			rz = rzNew;
+			for( int32 i = 0; i < num; ++i )
+			{
+				P[ i ] = Z[ i ] + beta * P[ i ];
+			}
+		}
+		return iteration;
+	}
+
+private:
+	void Multiply( const TArray< float >& x, TArray< float >& out_y ) const
+	{
+		for( int32 row = 0; row < Num(); ++row )
+		{
+			float sum = 0.f;
+			for( int32 entry = RowStart[ row ]; entry < RowStart[ row + 1 ]; ++entry )
+			{
+				sum += Values[ entry ] * x[ Columns[ entry ] ];
+			}
+			out_y[ row ] = sum;
+		}
+	}
+
+	static float Dot( const TArray< float >& a, const TArray< float >& b )
+	{
+		float sum = 0.f;
+		for( int32 i = 0; i < a.Num(); ++i )
+		{
+			sum += a[ i ] * b[ i ];
+		}
+		return sum;
+	}
+
+private:
+	/** The matrix in compressed sparse row form, the diagonal is the first entry of each row. */
+	TArray< int32 > RowStart;
+	TArray< int32 > Columns;
+	TArray< float > Values;
+	TArray< float > InvDiagonal;
+
+	/** Scratch for the iterations, kept to avoid allocating every tick. */
+	TArray< float > R;
+	TArray< float > Z;
+	TArray< float > P;
+	TArray< float > AP;
+};
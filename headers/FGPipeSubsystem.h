@@ -120,8 +120,19 @@ public:
 private:
 	int32 GenerateUniqueID();
 
+	/**
+	 * Simulate all networks.
+	 * Networks share no state so they are simulated as parallel tasks, all substeps of a network in the same task.
+	 * Anything a network does outside itself is deferred to AFGPipeNetwork::PostUpdateSimulation, which is called on the game thread in network id order so the result is the same regardless of the task order.
+	 */
 	void TickPipeNetworks( float dt );
 
+	/**
+	 * Sort the networks that should tick by size, largest first, and split them into tasks, see mTickTaskStarts.
+	 * Only done when a network is added, removed or rebuilt.
+	 */
+	void UpdateSortedTickNetworks();
+
 	/**
 	 * Internal helper to rebuild a network.
 	 * Note: This function might split, remove or otherwise change the network so it is not safe to assume anything about the network afterwards.
@@ -181,6 +192,10 @@ public:
 	//@todo-Pipes: These as tunable "consts" for now
 	static float TARGET_DELTA_SECONDS;
 	static int32 MAX_SUBSTEPS;
+	/** Simulate the networks in parallel. */
+	static bool PARALLEL_SIMULATION;
+	/** Networks with fewer junctions than this are packed together into tasks of about this many junctions, they are not worth a task each. */
+	static int32 MIN_JUNCTIONS_PER_TASK;
 	
 private:
 	int32 mIDCounter;
@@ -189,6 +204,21 @@ private:
 	UPROPERTY()
 	TMap< int32, class AFGPipeNetwork* > mNetworks;
 
+	/**
+	 * Networks to tick sorted by junction count, largest first so the big networks start first and the small ones fill in on the other workers.
+	 * Ties are sorted by network id to keep the order deterministic.
+	 */
+	TArray< class AFGPipeNetwork* > mSortedTickNetworks;
+
+	/**
+	 * Index in mSortedTickNetworks where each task starts, a task runs the networks up to where the next one starts.
+	 * Large networks get a task each, the small ones are packed into tasks of about MIN_JUNCTIONS_PER_TASK junctions so many small networks still spread over the workers.
+	 */
+	TArray< int32 > mTickTaskStarts;
+
+	/** If the networks have changed since mSortedTickNetworks was sorted. */
+	bool mSortedTickNetworksDirty;
+
 	/** List of networks to show debug for, if empty all networks are displayed. */
 	UPROPERTY()
 	TArray< class AFGPipeNetwork* > mDisplayDebugNetworkList;
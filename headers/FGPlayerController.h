@@ -5,6 +5,7 @@
 #include "FGCharacterPlayer.h"
 #include "FGPlayerState.h"
 #include "PlayerPresenceState.h"
+#include "FGRepresentationReplication.h"
 #include "FGPlayerController.generated.h"
 
 
@@ -209,9 +210,17 @@ public:
 	UFUNCTION( Reliable, Server, WithValidation )
 	void Server_RequestFogOfWarData();
 
-	/** Transfer fog of war data to the client */
+	/** Transfer fog of war tiles to the client */
 	UFUNCTION( Reliable, Client )
-	void Client_TransferFogOfWarData( const TArray<uint8>& fogOfWarRawData, int32 index );
+	void Client_TransferFogOfWarData( const TArray<uint8>& fogOfWarTiles );
+
+	/** Send the positions of the moving actor representations relevant to this client, see AFGActorRepresentationManager */
+	UFUNCTION( Unreliable, Client )
+	void Client_UpdateRepresentationPositions( const FRepresentationPositionBatch& batch );
+
+	/** Acknowledge a batch of representation positions, the server keeps resending a change until it is acknowledged */
+	UFUNCTION( Unreliable, Server, WithValidation )
+	void Server_AckRepresentationPositions( uint32 sequence );
 
 	/** Gets the size on the viewport of the given actor */
 	UFUNCTION( BlueprintPure, Category = "HUD" )
@@ -5,6 +5,9 @@
 #include "CoreMinimal.h"
 #include "FGCircuit.h"
 #include "FGNetSerialization.h"
+#include "FGRemoteCallObject.h"
+#include "FGPowerInfoTable.h"
+#include "FGPowerHistory.h"
 #include "FGPowerCircuit.generated.h"
 
 /**
@@ -40,7 +43,10 @@ struct TStructOpsTypeTraits< FPowerGraphPoint > : public TStructOpsTypeTraitsBas
 
 
 /**
- * Stats for a power circuit, refreshed once every second. Implemented as a ring buffer, so that we don't have to re-replicate all the time
+ * Stats for a power circuit, refreshed once every second.
+ * The history is kept in tiers of seconds, minutes and hours with min, max and average, see FPowerHistoryTier.
+ * The tiers are not replicated with the stats. The second tier is replicated by the circuit to everyone as it's what the power graphs show,
+ * the other tiers are only sent to the connections subscribed to them, see UFGPowerCircuitRemoteCallObject.
  */
 USTRUCT( BlueprintType )
 struct FPowerCircuitStats
@@ -48,10 +54,12 @@ struct FPowerCircuitStats
 	GENERATED_BODY()
 public:
 	FPowerCircuitStats();
-	bool NetSerialize( FArchive& ar, class UPackageMap* map, bool& out_success );
 
-	/** Helper to make a new graph point. */
-	FPowerGraphPoint& MakeAndAddGraphPoint();
+	/**
+	 * Add a point to the second tier, it is aggregated into the minute and hour tiers as they fill up.
+	 * @return Bit per tier that got a new point.
+	 */
+	uint8 AddGraphPoint( const FPowerGraphPoint& point );
 
 	/** Helper to make a new graph point from current time */
 	FORCEINLINE void MakeGraphPoint( FPowerGraphPoint& out_newGraphPoint ) const;
@@ -59,15 +67,18 @@ public:
 	/** Get the last graph point in the stats */
 	FORCEINLINE void GetLastGraphPoint( FPowerGraphPoint& out_newGraphPoint ) const;
 
-	/** Advances the graph and gets the next graph point we want to write to. */
-	FPowerGraphPoint& AdvanceToNextGraphPoint();
-
-	/** Get the number of points in our graph */
-	FORCEINLINE int32 GetNumGraphPoints() const{ return Items.Num(); }
+	/** Get the number of points in our graph, i.e. in the second tier. */
+	FORCEINLINE int32 GetNumGraphPoints() const{ return GetTier( EPowerHistoryTier::PHT_Second ).Num(); }
 
 	/** Get item of index in our graph @return false if the index is invalid */
 	FORCEINLINE bool GetGraphPointAtIndex( int32 idx, FPowerGraphPoint& out_graphPoint ) const;
 
+	/** Get a history tier, only the second tier and the tiers subscribed to by this client are valid on clients. */
+	FORCEINLINE const FPowerHistoryTier& GetTier( EPowerHistoryTier tier ) const { return HistoryTiers[ ( int32 )tier ]; }
+
+	/** The tiers the replicated points are written to on the client. */
+	FORCEINLINE FPowerHistoryTier* GetMutableTiers() { return HistoryTiers; }
+
 public:
 	/** The duration between each stat. */
 	UPROPERTY( BlueprintReadOnly, NotReplicated )
@@ -98,26 +109,14 @@ public:
 	bool HasPinnedGraphPoint;
 	FPowerGraphPoint PinnedGraphPoint;
 
-private:
-	/** All the points on the graph. */
-	UPROPERTY()
-	TArray< FPowerGraphPoint > Items;
+	/** Number of points kept per tier, two minutes of seconds, two hours of minutes and a day of hours. */
+	static constexpr int32 NUM_SECOND_POINTS = 120;
+	static constexpr int32 NUM_MINUTE_POINTS = 120;
+	static constexpr int32 NUM_HOUR_POINTS = 24;
 
-	/** The index we count as the first index in our ring buffer */
-	UPROPERTY()
-	int8 FirstIndex;
-
-	/** Maximum number of points in the graph. */
-	int32 NumGraphPointsMax;
-};
-
-template<>
-struct TStructOpsTypeTraits< FPowerCircuitStats > : public TStructOpsTypeTraitsBase2< FPowerCircuitStats >
-{
-	enum
-	{
-		WithNetSerializer = true
-	};
+private:
+	/** The history in each resolution, each point in a tier aggregates a number of points from the tier below. */
+	FPowerHistoryTier HistoryTiers[ ( int32 )EPowerHistoryTier::PHT_MAX ];
 };
 
 
@@ -154,6 +153,37 @@ public:
 	UFUNCTION( BlueprintPure, Category = "FactoryGame|Circuits|PowerCircuit" )
 	static int32 GetNumGraphPoint( const FPowerCircuitStats& stats ){ return stats.GetNumGraphPoints(); }
 
+	/** Get the number of points in a history tier, 0 if not subscribed. */
+	UFUNCTION( BlueprintPure, Category = "FactoryGame|Circuits|PowerCircuit" )
+	static int32 GetNumHistoryPoints( const FPowerCircuitStats& stats, EPowerHistoryTier tier ){ return stats.GetTier( tier ).Num(); }
+
+	/** Get the min, max and average of a point in a history tier, index 0 is the oldest. @return false if the index is invalid */
+	UFUNCTION( BlueprintPure, Category = "FactoryGame|Circuits|PowerCircuit" )
+	static bool GetHistoryPointAtIndex( const FPowerCircuitStats& stats, EPowerHistoryTier tier, int32 idx, FPowerGraphPoint& out_min, FPowerGraphPoint& out_max, FPowerGraphPoint& out_avg );
+
+	/**
+	 * Subscribe to a history tier, e.g. when a UI showing it is opened. The tier is only replicated to the subscribed player's connection.
+	 * On clients this is sent to the server through the player controller's UFGPowerCircuitRemoteCallObject.
+	 */
+	UFUNCTION( BlueprintCallable, Category = "FactoryGame|Circuits|PowerCircuit" )
+	void SubscribeToHistoryTier( class AFGPlayerController* playerController, EPowerHistoryTier tier );
+
+	/** Stop getting the tier, the tier is cleared on the client so it does not show stale points. */
+	UFUNCTION( BlueprintCallable, Category = "FactoryGame|Circuits|PowerCircuit" )
+	void UnsubscribeFromHistoryTier( class AFGPlayerController* playerController, EPowerHistoryTier tier );
+
+	/** Server only, add or remove a subscriber, the tier's points are sent through the subscriber which only replicates to its own connection. */
+	void SetHistoryTierSubscribed( class UFGPowerCircuitRemoteCallObject* subscriber, EPowerHistoryTier tier, bool subscribe );
+
+	/** Server only, remove a subscriber from all tiers, e.g. when its player logs out. */
+	void RemoveHistoryTierSubscriber( class UFGPowerCircuitRemoteCallObject* subscriber );
+
+	/** Client only, write a point received through a UFGPowerCircuitRemoteCallObject into the tier. */
+	void SetReplicatedHistoryPoint( EPowerHistoryTier tier, uint32 revision, const float ( &values )[ FPowerHistoryTier::NUM_COLUMNS ] );
+
+	/** Client only, clear a tier that is no longer replicated to this client. */
+	void ClearReplicatedHistoryTier( EPowerHistoryTier tier );
+
 	/** Debug */
 	virtual void DisplayDebug( class UCanvas* canvas, const class FDebugDisplayInfo& debugDisplay, float& YL, float& YPos, float indent ) override;
 
@@ -172,6 +202,15 @@ private:
 	/** Let the stats now the fuse got triggered. */
 	void StatFuseTriggered();
 
+	/** Rebuild mPowerInfoTable from mPowerInfos and assign the table indices, done when the circuit changes. */
+	void RebuildPowerInfoTable();
+
+	/**
+	 * Write the result of the tick back to the power infos that changed, and the demand factor to the dynamic producers.
+	 * Broadcasts OnHasPowerChangedDelegate for the ones where the power state changed.
+	 */
+	void WriteBackPowerInfos( float dynamicProductionDemandFactor );
+
 	/** Called when the fuse is set/reset in the circuit. */
 	void OnFuseSet();
 	void OnFuseReset();
@@ -180,6 +219,18 @@ private:
 	/** All power infos in this circuit, in the order they should be updated. */
 	TArray< class UFGPowerInfoComponent* > mPowerInfos;
 
+	/** Power values of mPowerInfos, the tick sums these instead of visiting each component. */
+	FPowerInfoTable mPowerInfoTable;
+
+	/** Indices in mPowerInfoTable with a dynamic production capacity, they get the demand factor every tick. */
+	TArray< int32 > mDynamicProducerIndices;
+
+	/** Scratch for the entries that changed during the tick, kept to avoid allocating. */
+	TArray< int32 > mChangedPowerInfoIndices;
+
+	/** Last demand factor written to the dynamic producers. */
+	float mLastDynamicProductionDemandFactor;
+
 	/** Total amount of energy that can be produced in the circuit. Used for stats. */
 	UPROPERTY()
 	float mPowerProductionCapacity;
@@ -204,6 +255,151 @@ private:
 	/** The power consumption/production over time. Used for feedback. */
 	UPROPERTY( Replicated )
 	FPowerCircuitStats mPowerStats;
+
+	/** The points of the second tier, written into mPowerStats on clients. Only the new points are sent to each connection. */
+	UPROPERTY( Replicated )
+	FPowerHistoryPointArray mPowerHistoryPoints;
+
+	/**
+	 * The subscribers per tier, the second tier is not used as it goes to everyone. Server only.
+	 * Weak as the subscribers go away with their player controller, invalid entries are dropped when the tier gets a new point.
+	 */
+	TArray< TWeakObjectPtr< class UFGPowerCircuitRemoteCallObject > > mHistoryTierSubscribers[ ( int32 )EPowerHistoryTier::PHT_MAX ];
+};
+
+/**
+ * A point in a history tier of a circuit, sent to a single connection.
+ */
+USTRUCT()
+struct FPowerHistorySubscriptionItem : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	FPowerHistorySubscriptionItem() :
+		Circuit( nullptr ),
+		Tier( EPowerHistoryTier::PHT_Second ),
+		Revision( 0 )
+	{
+		FMemory::Memzero( Values );
+	}
+
+	/** Writes the point into the circuit's tier. */
+	void PostReplicatedAdd( const struct FPowerHistorySubscriptionArray& inArraySerializer );
+	void PostReplicatedChange( const struct FPowerHistorySubscriptionArray& inArraySerializer );
+	/** Clears the circuit's tier, the items of a tier are only removed when it is unsubscribed. */
+	void PreReplicatedRemove( const struct FPowerHistorySubscriptionArray& inArraySerializer );
+
+	UPROPERTY()
+	class UFGPowerCircuit* Circuit;
+
+	UPROPERTY()
+	EPowerHistoryTier Tier;
+
+	/** The tier's revision when this point was added, see FPowerHistoryPointItem::Revision. */
+	UPROPERTY()
+	uint32 Revision;
+
+	/** All aggregates in the column order of FPowerHistoryTier. */
+	UPROPERTY()
+	float Values[ 9 ];
+};
+
+/**
+ * The points of the tiers one connection is subscribed to, for all circuits, one item per point and ring slot like FPowerHistoryPointArray.
+ * Lives on the connection's UFGPowerCircuitRemoteCallObject, so the points are only sent to the subscribed connection.
+ */
+USTRUCT()
+struct FPowerHistorySubscriptionArray : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	static_assert( FPowerHistoryTier::NUM_COLUMNS == 9, "FPowerHistorySubscriptionItem::Values must hold all columns." );
+
+	/** Server only, send all points of a circuit's tier, when subscribed. */
+	void AddTier( class UFGPowerCircuit* circuit, EPowerHistoryTier tier, const FPowerHistoryTier& history )
+	{
+		RemoveTier( circuit, tier );
+		for( int32 idx = 0; idx < history.Num(); ++idx )
+		{
+			FPowerHistorySubscriptionItem& item = Items.AddDefaulted_GetRef();
+			item.Circuit = circuit;
+			item.Tier = tier;
+			item.Revision = history.Revision - history.Num() + idx + 1;
+			history.GetPointValues( idx, item.Values );
+			MarkItemDirty( item );
+		}
+	}
+
+	/** Server only, stop sending a circuit's tier, when unsubscribed. The client clears the tier when the items are removed. */
+	void RemoveTier( class UFGPowerCircuit* circuit, EPowerHistoryTier tier )
+	{
+		if( Items.RemoveAllSwap( [ circuit, tier ]( const FPowerHistorySubscriptionItem& item ) { return item.Circuit == circuit && item.Tier == tier; } ) > 0 )
+		{
+			MarkArrayDirty();
+		}
+	}
+
+	/** Server only, send the newest point of a circuit's tier, replaces the point it overwrote in the ring. */
+	void AddPoint( class UFGPowerCircuit* circuit, EPowerHistoryTier tier, const FPowerHistoryTier& history )
+	{
+		const int32 slot = ( history.Revision - 1 ) % history.GetCapacity();
+		FPowerHistorySubscriptionItem* item = Items.FindByPredicate( [ & ]( const FPowerHistorySubscriptionItem& other )
+		{
+			return other.Circuit == circuit && other.Tier == tier && static_cast< int32 >( ( other.Revision - 1 ) % history.GetCapacity() ) == slot;
+		} );
+		if( !item )
+		{
+			item = &Items.AddDefaulted_GetRef();
+			item->Circuit = circuit;
+			item->Tier = tier;
+		}
+		item->Revision = history.Revision;
+		history.GetLastPointValues( item->Values );
+		MarkItemDirty( *item );
+	}
+
+	bool NetDeltaSerialize( FNetDeltaSerializeInfo& deltaParms )
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize< FPowerHistorySubscriptionItem, FPowerHistorySubscriptionArray >( Items, deltaParms, *this );
+	}
+
+	UPROPERTY()
+	TArray< FPowerHistorySubscriptionItem > Items;
+};
+
+template<>
+struct TStructOpsTypeTraits< FPowerHistorySubscriptionArray > : public TStructOpsTypeTraitsBase2< FPowerHistorySubscriptionArray >
+{
+	enum
+	{
+		WithNetDeltaSerializer = true
+	};
+};
+
+/**
+ * Lets clients subscribe to the power history tiers of a circuit.
+ * Owned by the player controller so it only replicates to that player's connection, the subscribed tiers are sent through it.
+ */
+UCLASS()
+class UFGPowerCircuitRemoteCallObject : public UFGRemoteCallObject
+{
+	GENERATED_BODY()
+public:
+	virtual void GetLifetimeReplicatedProps( TArray< FLifetimeProperty >& OutLifetimeProps ) const override;
+
+	UPROPERTY( Replicated, Meta = ( NoAutoJson ) )
+	bool mForceNetField_UFGPowerCircuitRemoteCallObject = false;
+
+	UFUNCTION( Reliable, Server, WithValidation )
+	void Server_SetHistoryTierSubscribed( UFGPowerCircuit* circuit, EPowerHistoryTier tier, bool subscribe );
+
+	/** Server only, called by the circuits this is subscribed to. */
+	FORCEINLINE FPowerHistorySubscriptionArray& GetSubscribedHistoryPoints() { return mSubscribedHistoryPoints; }
+
+private:
+	/** The points of the tiers this player is subscribed to. */
+	UPROPERTY( Replicated )
+	FPowerHistorySubscriptionArray mSubscribedHistoryPoints;
 };
 
 void FPowerCircuitStats::MakeGraphPoint( FPowerGraphPoint& out_newGraphPoint ) const
@@ -215,7 +411,8 @@ void FPowerCircuitStats::MakeGraphPoint( FPowerGraphPoint& out_newGraphPoint ) c
 
 bool FPowerCircuitStats::GetGraphPointAtIndex( int32 idx, FPowerGraphPoint& out_graphPoint ) const
 {
-	if( idx < 0 || idx >= Items.Num() )
+	const FPowerHistoryTier& tier = GetTier( EPowerHistoryTier::PHT_Second );
+	if( idx < 0 || idx >= tier.Num() )
 	{
 		out_graphPoint.Consumed = 0;
 		out_graphPoint.Produced = 0;
@@ -224,14 +421,14 @@ bool FPowerCircuitStats::GetGraphPointAtIndex( int32 idx, FPowerGraphPoint& out_
 		return false;
 	}
 
-	const int32 nextIdx = ( FirstIndex + 1 + idx ) % NumGraphPointsMax;
-
-	out_graphPoint = Items[ nextIdx ];
+	out_graphPoint.Consumed = tier.Get( idx, EPowerHistoryValue::PHV_Consumed, FPowerHistoryTier::Avg );
+	out_graphPoint.Produced = tier.Get( idx, EPowerHistoryValue::PHV_Produced, FPowerHistoryTier::Avg );
+	out_graphPoint.ProductionCapacity = tier.Get( idx, EPowerHistoryValue::PHV_ProductionCapacity, FPowerHistoryTier::Avg );
 
 	return true;
 }
 
 void FPowerCircuitStats::GetLastGraphPoint( FPowerGraphPoint& out_newGraphPoint ) const
 {
-	GetGraphPointAtIndex( NumGraphPointsMax - 1, out_newGraphPoint );
+	GetGraphPointAtIndex( GetNumGraphPoints() - 1, out_newGraphPoint );
 }
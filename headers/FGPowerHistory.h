@@ -0,0 +1,316 @@
+// Copyright 2016-2020 Coffee Stain Studios. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/NetSerialization.h"
+#include "FGPowerHistory.generated.h"
+
+/** The resolutions the power history is kept in. */
+UENUM( BlueprintType )
+enum class EPowerHistoryTier : uint8
+{
+	PHT_Second		UMETA( DisplayName = "Second" ),
+	PHT_Minute		UMETA( DisplayName = "Minute" ),
+	PHT_Hour		UMETA( DisplayName = "Hour" ),
+	PHT_MAX			UMETA( Hidden )
+};
+
+/** The values recorded in the power history. */
+enum class EPowerHistoryValue : uint8
+{
+	PHV_Consumed,
+	PHV_Produced,
+	PHV_ProductionCapacity,
+	PHV_MAX
+};
+
+/**
+ * One resolution of the power history, a ring buffer of aggregated points.
+ * Stored as columns, one array per value and aggregate, so a graph can read a single column without touching the rest.
+ */
+struct FPowerHistoryTier
+{
+	/** The aggregates kept for each value. */
+	enum EAggregate : uint8
+	{
+		Min,
+		Max,
+		Avg,
+		NumAggregates
+	};
+
+	static constexpr int32 NUM_COLUMNS = ( int32 )EPowerHistoryValue::PHV_MAX * NumAggregates;
+
+	/** Set the number of points kept, clears the history. */
+	void Init( int32 capacity, int32 samplesPerPoint )
+	{
+		Capacity = FMath::Max( capacity, 1 );
+		SamplesPerPoint = FMath::Max( samplesPerPoint, 1 );
+		for( TArray< float >& column : Columns )
+		{
+			column.SetNumZeroed( Capacity );
+		}
+		Head = 0;
+		NumPoints = 0;
+		ResetAccumulator();
+	}
+
+	FORCEINLINE int32 Num() const { return NumPoints; }
+	FORCEINLINE int32 GetCapacity() const { return Capacity; }
+
+	/** Drop all points but keep the capacity, used on clients when a tier stops being replicated so it does not show stale points. */
+	void Clear()
+	{
+		Head = 0;
+		NumPoints = 0;
+		Revision = 0;
+		ResetAccumulator();
+	}
+
+	/** Get a value, index 0 is the oldest point. */
+	FORCEINLINE float Get( int32 idx, EPowerHistoryValue value, EAggregate aggregate ) const
+	{
+		const int32 slot = ( Head - NumPoints + idx + Capacity ) % Capacity;
+		return Columns[ GetColumn( value, aggregate ) ][ slot ];
+	}
+
+	/**
+	 * Add a sample, or a point from the tier below, to the point being accumulated.
+	 * @return true if the point is complete and was added, the point should then be passed on to the tier above.
+	 */
+	bool AddSample( const float ( &min )[ ( int32 )EPowerHistoryValue::PHV_MAX ], const float ( &max )[ ( int32 )EPowerHistoryValue::PHV_MAX ], const float ( &avg )[ ( int32 )EPowerHistoryValue::PHV_MAX ] )
+	{
+		for( int32 v = 0; v < ( int32 )EPowerHistoryValue::PHV_MAX; ++v )
+		{
+			AccumulatedMin[ v ] = AccumulatedSamples > 0 ? FMath::Min( AccumulatedMin[ v ], min[ v ] ) : min[ v ];
+			AccumulatedMax[ v ] = AccumulatedSamples > 0 ? FMath::Max( AccumulatedMax[ v ], max[ v ] ) : max[ v ];
+			AccumulatedSum[ v ] += avg[ v ];
+		}
+
+		if( ++AccumulatedSamples < SamplesPerPoint )
+		{
+			return false;
+		}
+
+		for( int32 v = 0; v < ( int32 )EPowerHistoryValue::PHV_MAX; ++v )
+		{
+			Columns[ GetColumn( ( EPowerHistoryValue )v, Min ) ][ Head ] = AccumulatedMin[ v ];
+			Columns[ GetColumn( ( EPowerHistoryValue )v, Max ) ][ Head ] = AccumulatedMax[ v ];
+			Columns[ GetColumn( ( EPowerHistoryValue )v, Avg ) ][ Head ] = AccumulatedSum[ v ] / AccumulatedSamples;
+		}
+		Head = ( Head + 1 ) % Capacity;
+		NumPoints = FMath::Min( NumPoints + 1, Capacity );
+		++Revision;
+		ResetAccumulator();
+		return true;
+	}
+
+	/** Get all aggregates of the newest point in column order. */
+	void GetLastPointValues( float ( &out_values )[ NUM_COLUMNS ] ) const
+	{
+		const int32 slot = ( Head - 1 + Capacity ) % Capacity;
+		for( int32 c = 0; c < NUM_COLUMNS; ++c )
+		{
+			out_values[ c ] = Columns[ c ][ slot ];
+		}
+	}
+
+	/** Get all aggregates of a point in column order, index 0 is the oldest point. */
+	void GetPointValues( int32 idx, float ( &out_values )[ NUM_COLUMNS ] ) const
+	{
+		const int32 slot = ( Head - NumPoints + idx + Capacity ) % Capacity;
+		for( int32 c = 0; c < NUM_COLUMNS; ++c )
+		{
+			out_values[ c ] = Columns[ c ][ slot ];
+		}
+	}
+
+	/**
+	 * Write a point received from the server, revision is the Revision of the tier on the server when the point was added.
+	 * The slot is derived from the revision so points can arrive in any order, the newest revision decides the head.
+	 */
+	void SetPoint( uint32 revision, const float ( &values )[ NUM_COLUMNS ] )
+	{
+		if( revision == 0 )
+		{
+			return;
+		}
+		const int32 slot = ( revision - 1 ) % Capacity;
+		for( int32 c = 0; c < NUM_COLUMNS; ++c )
+		{
+			Columns[ c ][ slot ] = values[ c ];
+		}
+		if( revision > Revision )
+		{
+			Revision = revision;
+			Head = Revision % Capacity;
+			NumPoints = FMath::Min( static_cast< int32 >( Revision ), Capacity );
+		}
+	}
+
+	/** Get the last completed point, for passing on to the tier above. */
+	void GetLastPoint( float ( &out_min )[ ( int32 )EPowerHistoryValue::PHV_MAX ], float ( &out_max )[ ( int32 )EPowerHistoryValue::PHV_MAX ], float ( &out_avg )[ ( int32 )EPowerHistoryValue::PHV_MAX ] ) const
+	{
+		for( int32 v = 0; v < ( int32 )EPowerHistoryValue::PHV_MAX; ++v )
+		{
+			out_min[ v ] = Get( NumPoints - 1, ( EPowerHistoryValue )v, Min );
+			out_max[ v ] = Get( NumPoints - 1, ( EPowerHistoryValue )v, Max );
+			out_avg[ v ] = Get( NumPoints - 1, ( EPowerHistoryValue )v, Avg );
+		}
+	}
+
+	/** Number of points ever added, the newest point is at slot ( Revision - 1 ) % Capacity. */
+	uint32 Revision = 0;
+
+private:
+	static FORCEINLINE int32 GetColumn( EPowerHistoryValue value, EAggregate aggregate )
+	{
+		return ( int32 )value * NumAggregates + aggregate;
+	}
+
+	void ResetAccumulator()
+	{
+		AccumulatedSamples = 0;
+		for( int32 v = 0; v < ( int32 )EPowerHistoryValue::PHV_MAX; ++v )
+		{
+			AccumulatedMin[ v ] = 0.f;
+			AccumulatedMax[ v ] = 0.f;
+			AccumulatedSum[ v ] = 0.f;
+		}
+	}
+
+private:
+	TArray< float > Columns[ NUM_COLUMNS ];
+
+	int32 Capacity = 1;
+	int32 SamplesPerPoint = 1;
+
+	/** Where the next point is written. */
+	int32 Head = 0;
+	int32 NumPoints = 0;
+
+	/** The point being accumulated from the samples. */
+	int32 AccumulatedSamples = 0;
+	float AccumulatedMin[ ( int32 )EPowerHistoryValue::PHV_MAX ];
+	float AccumulatedMax[ ( int32 )EPowerHistoryValue::PHV_MAX ];
+	float AccumulatedSum[ ( int32 )EPowerHistoryValue::PHV_MAX ];
+};
+
+/**
+ * A point in one of the replicated history tiers.
+ */
+USTRUCT()
+struct FPowerHistoryPointItem : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	FPowerHistoryPointItem() :
+		Tier( EPowerHistoryTier::PHT_Second ),
+		Revision( 0 )
+	{
+		FMemory::Memzero( Values );
+	}
+
+	void PostReplicatedAdd( const struct FPowerHistoryPointArray& inArraySerializer );
+	void PostReplicatedChange( const struct FPowerHistoryPointArray& inArraySerializer );
+
+	UPROPERTY()
+	EPowerHistoryTier Tier;
+
+	/** The tier's revision when this point was added, decides where in the ring the point goes on the client. */
+	UPROPERTY()
+	uint32 Revision;
+
+	/** All aggregates in the column order of FPowerHistoryTier. */
+	UPROPERTY()
+	float Values[ 9 ];
+};
+
+/**
+ * The points of a replicated history tier, one item per point and ring slot.
+ * Used by the circuit for the second tier which all connections get, the other tiers go per connection, see FPowerHistorySubscriptionArray.
+ * When a tier gets a new point the item in its slot is replaced and marked dirty, so each connection is only sent the points added since it was last updated.
+ * The client writes the received points into its FPowerHistoryTier rings.
+ */
+USTRUCT()
+struct FPowerHistoryPointArray : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	static_assert( FPowerHistoryTier::NUM_COLUMNS == 9, "FPowerHistoryPointItem::Values must hold all columns." );
+
+	/** Server only, send all points of a tier. */
+	void AddTier( EPowerHistoryTier tier, const FPowerHistoryTier& history )
+	{
+		RemoveTier( tier );
+		for( int32 idx = 0; idx < history.Num(); ++idx )
+		{
+			FPowerHistoryPointItem& item = Items.AddDefaulted_GetRef();
+			item.Tier = tier;
+			item.Revision = history.Revision - history.Num() + idx + 1;
+			history.GetPointValues( idx, item.Values );
+			MarkItemDirty( item );
+		}
+	}
+
+	/** Server only, stop sending a tier. */
+	void RemoveTier( EPowerHistoryTier tier )
+	{
+		if( Items.RemoveAllSwap( [ tier ]( const FPowerHistoryPointItem& item ) { return item.Tier == tier; } ) > 0 )
+		{
+			MarkArrayDirty();
+		}
+	}
+
+	/** Server only, send the newest point of a tier, replaces the point it overwrote in the ring. */
+	void AddPoint( EPowerHistoryTier tier, const FPowerHistoryTier& history )
+	{
+		const int32 slot = ( history.Revision - 1 ) % history.GetCapacity();
+		FPowerHistoryPointItem* item = Items.FindByPredicate( [ & ]( const FPowerHistoryPointItem& other )
+		{
+			return other.Tier == tier && static_cast< int32 >( ( other.Revision - 1 ) % history.GetCapacity() ) == slot;
+		} );
+		if( !item )
+		{
+			item = &Items.AddDefaulted_GetRef();
+			item->Tier = tier;
+		}
+		item->Revision = history.Revision;
+		history.GetLastPointValues( item->Values );
+		MarkItemDirty( *item );
+	}
+
+	bool NetDeltaSerialize( FNetDeltaSerializeInfo& deltaParms )
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize< FPowerHistoryPointItem, FPowerHistoryPointArray >( Items, deltaParms, *this );
+	}
+
+	UPROPERTY()
+	TArray< FPowerHistoryPointItem > Items;
+
+	/** The tiers the received points are written to on the client, set by the owning circuit. */
+	FPowerHistoryTier* Tiers = nullptr;
+};
+
+template<>
+struct TStructOpsTypeTraits< FPowerHistoryPointArray > : public TStructOpsTypeTraitsBase2< FPowerHistoryPointArray >
+{
+	enum
+	{
+		WithNetDeltaSerializer = true
+	};
+};
+
+FORCEINLINE void FPowerHistoryPointItem::PostReplicatedAdd( const FPowerHistoryPointArray& inArraySerializer )
+{
+	if( inArraySerializer.Tiers )
+	{
+		inArraySerializer.Tiers[ ( int32 )Tier ].SetPoint( Revision, Values );
+	}
+}
+
+FORCEINLINE void FPowerHistoryPointItem::PostReplicatedChange( const FPowerHistoryPointArray& inArraySerializer )
+{
+	PostReplicatedAdd( inArraySerializer );
+}
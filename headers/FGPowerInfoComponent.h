@@ -7,6 +7,8 @@
 #include "FGSaveInterface.h"
 #include "FGPowerInfoComponent.generated.h"
 
+/** Native delegate for when the power state of a power info changes, broadcast from the circuit tick. */
+DECLARE_MULTICAST_DELEGATE_OneParam( FOnPowerInfoHasPowerChanged, bool /* hasPower */ );
 
 /**
  * Default implementation for a powered building.
@@ -127,9 +129,16 @@ public:
 	 */
 	void SetCircuitID( int32 circuitID );
 
+	/** Write our target consumption, base production and dynamic capacity to the circuit's table, called by the setters. */
+	void UpdatePowerInfoTableEntry();
+
 	/** Debug */
 	void DisplayDebug( class UCanvas* canvas, const class FDebugDisplayInfo& debugDisplay, float& YL, float& YPos );
 
+public:
+	/** Broadcast when mHasPower or mIsFuseTriggered changes, e.g. used to wake up sleeping factories. */
+	FOnPowerInfoHasPowerChanged OnHasPowerChangedDelegate;
+
 private:
 	/** If we should replicate detailed information. */
 	bool IsReplicatingDetails() const { return mReplicateDetails; }
@@ -173,6 +182,9 @@ private:
 	/** Do we have enough of the requested power. */
 	uint8 mHasPower:1;
 
+	/** Index in the circuit's FPowerInfoTable, the setters write the new values there. INDEX_NONE if not connected. */
+	int32 mPowerInfoTableIndex;
+
 	/** true if the circuit is overloaded and the fuse has been triggered. */
 	UPROPERTY( Replicated )
 	uint8 mIsFuseTriggered:1;
@@ -0,0 +1,94 @@
+// Copyright 2016-2020 Coffee Stain Studios. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/VectorRegister.h"
+
+/**
+ * Packed power values for all power infos in a circuit, one array per value.
+ *
+ * The power infos write their requests into the table through their index when they change, the circuit tick then only reads the arrays.
+ * The results are written back to the power info components only for the entries that actually changed.
+ */
+struct FPowerInfoTable
+{
+	FORCEINLINE int32 Num() const { return Infos.Num(); }
+
+	void Reset()
+	{
+		Infos.Reset();
+		TargetConsumption.Reset();
+		BaseProduction.Reset();
+		DynamicProductionCapacity.Reset();
+		ActualConsumption.Reset();
+		HasPower.Reset();
+	}
+
+	/** Add an entry, the power info should keep the index to write its values. @return the index. */
+	int32 Add( class UFGPowerInfoComponent* info, float targetConsumption, float baseProduction, float dynamicProductionCapacity )
+	{
+		const int32 index = Infos.Add( info );
+		TargetConsumption.Add( targetConsumption );
+		BaseProduction.Add( baseProduction );
+		DynamicProductionCapacity.Add( dynamicProductionCapacity );
+		ActualConsumption.Add( 0.f );
+		HasPower.Add( 0 );
+		return index;
+	}
+
+	/** Sum of an array, four lanes at a time. */
+	static float Sum( const TArray< float >& values )
+	{
+		const float* data = values.GetData();
+		const int32 num = values.Num();
+		const int32 numVectorized = num & ~3;
+
+		VectorRegister sum = VectorZero();
+		for( int32 i = 0; i < numVectorized; i += 4 )
+		{
+			sum = VectorAdd( sum, VectorLoad( data + i ) );
+		}
+
+		float lanes[ 4 ];
+		VectorStore( sum, lanes );
+		float result = ( lanes[ 0 ] + lanes[ 1 ] ) + ( lanes[ 2 ] + lanes[ 3 ] );
+		for( int32 i = numVectorized; i < num; ++i )
+		{
+			result += data[ i ];
+		}
+		return result;
+	}
+
+	/**
+	 * Set the result of the tick for all entries, the consumers get their target if the circuit has power and nothing otherwise.
+	 * @param out_changed - Indices of the entries where the result changed and needs to be written back to the power info.
+	 */
+	void ApplyResult( bool hasPower, TArray< int32 >& out_changed )
+	{
+		out_changed.Reset();
+		const uint8 newHasPower = hasPower ? 1 : 0;
+		for( int32 i = 0; i < Infos.Num(); ++i )
+		{
+			const float newConsumption = hasPower ? TargetConsumption[ i ] : 0.f;
+			if( HasPower[ i ] != newHasPower || ActualConsumption[ i ] != newConsumption )
+			{
+				HasPower[ i ] = newHasPower;
+				ActualConsumption[ i ] = newConsumption;
+				out_changed.Add( i );
+			}
+		}
+	}
+
+	/** The power infos, only touched for the write back. */
+	TArray< class UFGPowerInfoComponent* > Infos;
+
+	/** Written by the power infos. */
+	TArray< float > TargetConsumption;
+	TArray< float > BaseProduction;
+	TArray< float > DynamicProductionCapacity;
+
+	/** The result last written back to the power infos. */
+	TArray< float > ActualConsumption;
+	TArray< uint8 > HasPower;
+};
@@ -6,6 +6,7 @@
 #include "FGSubsystem.h"
 #include "FGSaveInterface.h"
 #include "FGGamePhaseManager.h"
+#include "Resources/FGItemRegistry.h"
 #include "FGRecipeManager.generated.h"
 
 class UFGRecipe;
@@ -48,7 +49,7 @@ public:
 	UFUNCTION( BlueprintCallable, Category = "FactoryGame|Recipe" )
 	void GetAllAvailableRecipes( TArray< TSubclassOf< UFGRecipe > >& out_recipes );
 
-	/** Gets the available recipes for the given class, may not be null. */
+	/** Gets the available recipes for the given class, may not be null. Each recipe is listed once, in the order it was made available. */
 	UFUNCTION( BlueprintCallable, Category = "FactoryGame|Recipe" )
 	void GetAvailableRecipesForProducer( TSubclassOf< UObject > forProducer, TArray< TSubclassOf< UFGRecipe > >& out_recipes );
 
@@ -75,6 +76,22 @@ public:
 	void Debug_DumpStateToLog() const;
 
 private:
+	/** Add the recipe at recipeIdx in mAvailableRecipes to the ingredient, product and producer indices. */
+	void AddRecipeToIndex( int32 recipeIdx );
+
+	/**
+	 * Get the indices in mAvailableRecipes of the recipes for a producer, merged from the producer class and all its super classes.
+	 * The result is sorted and without duplicates, a recipe listing both a class and one of its super classes is only returned once.
+	 */
+	void GetRecipeIndicesForProducer( TSubclassOf< UObject > forProducer, TArray< int32 >& out_recipeIndices ) const;
+
+	/** Rebuild the indices from mAvailableRecipes, e.g. after loading or when replicated. Builds the FItemRegistry first if it has not been built. */
+	void RebuildRecipeIndex();
+
+	/** Rebuild the indices on clients. */
+	UFUNCTION()
+	void OnRep_AvailableRecipes();
+
 	/** Filters recipes for a given producer. */
 	void FilterRecipesByProducer( const TArray< TSubclassOf< UFGRecipe > >& inRecipes, TSubclassOf< UObject > forProducer, TArray< TSubclassOf< UFGRecipe > >& out_recipes );
 
@@ -83,6 +100,20 @@ private:
 	
 private:
 	/** All recipes that are available to the producers, i.e. build gun, workbench, manufacturers etc. */
-	UPROPERTY( SaveGame, Replicated )
+	UPROPERTY( SaveGame, ReplicatedUsing = OnRep_AvailableRecipes )
 	TArray< TSubclassOf< UFGRecipe > > mAvailableRecipes;
+
+	/**
+	 * Available recipes per item, indexed by the item's FItemRegistry id.
+	 * Lets FindRecipesByIngredient and FindRecipesByProduct look up the recipes directly instead of scanning all recipes.
+	 */
+	TArray< TArray< TSubclassOf< UFGRecipe > > > mRecipesByIngredient;
+	TArray< TArray< TSubclassOf< UFGRecipe > > > mRecipesByProduct;
+
+	/**
+	 * Indices in mAvailableRecipes of the recipes per producer class as listed in the recipes.
+	 * A producer gets the recipes of its own class and all its super classes, so the lookup walks the class hierarchy, which is only a few steps.
+	 * Indices rather than recipes so the merged result can be de-duplicated and put back in mAvailableRecipes order with a sort.
+	 */
+	TMap< UClass*, TArray< int32 > > mRecipeIndicesByProducer;
 };
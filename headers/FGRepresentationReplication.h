@@ -0,0 +1,212 @@
+// Copyright 2016-2020 Coffee Stain Studios. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FGActorRepresentation.h"
+#include "FGRepresentationReplication.generated.h"
+
+/**
+ * Position of a moving representation, quantized for the compass and the map.
+ * Location is in whole world space meters, yaw is 256 steps. Good enough for an icon, a fraction of a replicated FVector_NetQuantize and FRotator.
+ */
+USTRUCT()
+struct FRepresentationPosition
+{
+	GENERATED_BODY()
+public:
+	FRepresentationPosition() :
+		Representation( nullptr ),
+		LocationMeters( FIntVector::ZeroValue ),
+		QuantizedYaw( 0 )
+	{
+	}
+
+	static constexpr float METER = 100.f;
+
+	void Quantize( const FVector& location, const FRotator& rotation )
+	{
+		LocationMeters = FIntVector( FMath::RoundToInt( location.X / METER ), FMath::RoundToInt( location.Y / METER ), FMath::RoundToInt( location.Z / METER ) );
+		QuantizedYaw = FRotator::CompressAxisToByte( rotation.Yaw );
+	}
+
+	FORCEINLINE FVector GetLocation() const { return FVector( LocationMeters ) * METER; }
+	FORCEINLINE FRotator GetRotation() const { return FRotator( 0.f, FRotator::DecompressAxisFromByte( QuantizedYaw ), 0.f ); }
+
+	/** Serialized through the package map, null on the client if the representation has not been replicated to it. */
+	UPROPERTY()
+	UFGActorRepresentation* Representation;
+
+	FIntVector LocationMeters;
+	uint8 QuantizedYaw;
+};
+
+/**
+ * Positions of the moving representations relevant to a connection, sent unreliably as one batch instead of a property update per representation.
+ * Only representations that moved at least a meter or turned since the last position the connection acknowledged are included,
+ * so a change keeps being resent until a batch holding it is acknowledged. The client acknowledges each batch with its Sequence.
+ */
+USTRUCT()
+struct FRepresentationPositionBatch
+{
+	GENERATED_BODY()
+public:
+	/** Sanity limit when loading, a batch never holds more than this. */
+	static constexpr uint32 MAX_POSITIONS = 4096;
+
+	/** Representations are written as net GUIDs through the package map, locations as zig-zag varints. */
+	bool NetSerialize( FArchive& ar, class UPackageMap* map, bool& out_success )
+	{
+		ar.SerializeIntPacked( Sequence );
+
+		uint32 numPositions = Positions.Num();
+		ar.SerializeIntPacked( numPositions );
+		if( ar.IsLoading() )
+		{
+			if( numPositions > MAX_POSITIONS )
+			{
+				out_success = false;
+				return false;
+			}
+			Positions.SetNum( numPositions );
+		}
+
+		for( FRepresentationPosition& position : Positions )
+		{
+			UObject* representation = position.Representation;
+			map->SerializeObject( ar, UFGActorRepresentation::StaticClass(), representation );
+			position.Representation = Cast< UFGActorRepresentation >( representation );
+
+			for( int32 axis = 0; axis < 3; ++axis )
+			{
+				const int32 value = position.LocationMeters[ axis ];
+				uint32 zigZag = ( static_cast< uint32 >( value ) << 1 ) ^ static_cast< uint32 >( value >> 31 );
+				ar.SerializeIntPacked( zigZag );
+				position.LocationMeters[ axis ] = static_cast< int32 >( zigZag >> 1 ) ^ -static_cast< int32 >( zigZag & 1 );
+			}
+			ar << position.QuantizedYaw;
+		}
+
+		out_success = !ar.IsError();
+		return true;
+	}
+
+	/** Increases by one per batch sent to a connection, echoed back by the client to acknowledge the batch. */
+	uint32 Sequence = 0;
+
+	TArray< FRepresentationPosition > Positions;
+};
+
+template<>
+struct TStructOpsTypeTraits< FRepresentationPositionBatch > : public TStructOpsTypeTraitsBase2< FRepresentationPositionBatch >
+{
+	enum
+	{
+		WithNetSerializer = true
+	};
+};
+
+/**
+ * What a connection is interested in, derived from its player's filters and view location.
+ * A representation is relevant if the player can see it on the map, or on the compass within its compass view distance.
+ * Representations that reveal fog of war are always relevant as they feed the map.
+ *
+ * The client runs the same test on its own filters and pawn location to drop the representations the server stopped replicating to it.
+ * The server adds RELEVANCY_MARGIN to the compass distance so it keeps replicating a bit beyond where the client drops them.
+ */
+struct FRepresentationConnectionInterest
+{
+	/** Extra compass distance used on the server, covers the view location lag between server and client. */
+	static constexpr float RELEVANCY_MARGIN = 5000.f;
+
+	/** Filters from the player state, one bit per ERepresentationType. */
+	uint32 FilteredOutMapTypes = 0;
+	uint32 FilteredOutCompassTypes = 0;
+
+	FVector ViewLocation = FVector::ZeroVector;
+
+	/**
+	 * Representations currently replicated to the connection, the subobjects not in here are skipped in ReplicateSubobjects.
+	 * Weak so an entry never dangles, the manager also removes the representation from all interests when it is removed.
+	 */
+	TSet< TWeakObjectPtr< UFGActorRepresentation > > RelevantRepresentations;
+
+	/** A position the connection has acknowledged, with the sequence of the batch it came in. */
+	struct FAckedPosition
+	{
+		FRepresentationPosition Position;
+		uint32 Sequence = 0;
+	};
+
+	/** The last position acknowledged for each moving representation, to only send the ones that changed. Not updated until the client acknowledges. */
+	TMap< TWeakObjectPtr< UFGActorRepresentation >, FAckedPosition > AckedPositions;
+
+	/** Batches sent but not acknowledged yet, oldest first. */
+	TArray< FRepresentationPositionBatch > PendingBatches;
+
+	/** Sequence of the next batch to send. */
+	uint32 NextSequence = 1;
+
+	/** Older batches are dropped when more than this are in flight, their positions are resent as they were never acknowledged. */
+	static constexpr int32 MAX_PENDING_BATCHES = 16;
+
+	/** Move the positions of an acknowledged batch into AckedPositions, unless a later batch has already been acknowledged for a representation. */
+	void AcknowledgeBatch( uint32 sequence )
+	{
+		const int32 batchIdx = PendingBatches.IndexOfByPredicate( [ sequence ]( const FRepresentationPositionBatch& batch ) { return batch.Sequence == sequence; } );
+		if( batchIdx == INDEX_NONE )
+		{
+			return;
+		}
+		for( const FRepresentationPosition& position : PendingBatches[ batchIdx ].Positions )
+		{
+			FAckedPosition& acked = AckedPositions.FindOrAdd( position.Representation );
+			if( acked.Sequence < sequence )
+			{
+				acked.Position = position;
+				acked.Sequence = sequence;
+			}
+		}
+		PendingBatches.RemoveAt( batchIdx );
+	}
+
+	/** Forget a representation, e.g. when it is removed. */
+	void RemoveRepresentation( UFGActorRepresentation* representation )
+	{
+		RelevantRepresentations.Remove( representation );
+		AckedPositions.Remove( representation );
+	}
+
+	static FORCEINLINE uint32 GetTypeBit( ERepresentationType type ) { return 1u << static_cast< uint32 >( type ); }
+
+	static uint32 MakeTypeMask( const TArray< ERepresentationType >& types )
+	{
+		uint32 mask = 0;
+		for( ERepresentationType type : types )
+		{
+			mask |= GetTypeBit( type );
+		}
+		return mask;
+	}
+
+	/**
+	 * @param compassViewDistance - World distance for the representation's compass view distance, negative if always visible and 0 if off.
+	 * @param margin - Added to the compass view distance, RELEVANCY_MARGIN on the server and 0 on the client.
+	 */
+	bool IsRelevant( bool showOnMap, bool showInCompass, ERepresentationType type, EFogOfWarRevealType fogOfWarRevealType, float compassViewDistance, const FVector& location, float margin ) const
+	{
+		if( fogOfWarRevealType != EFogOfWarRevealType::FOWRT_None )
+		{
+			return true;
+		}
+		if( showOnMap && ( FilteredOutMapTypes & GetTypeBit( type ) ) == 0 )
+		{
+			return true;
+		}
+		if( showInCompass && ( FilteredOutCompassTypes & GetTypeBit( type ) ) == 0 )
+		{
+			return compassViewDistance < 0.f || ( compassViewDistance > 0.f && FVector::DistSquared( ViewLocation, location ) <= FMath::Square( compassViewDistance + margin ) );
+		}
+		return false;
+	}
+};
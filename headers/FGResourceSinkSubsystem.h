@@ -97,6 +97,7 @@ public:
 	*/
 	int32 RemoveResourceSinkCoupons( int32 numCoupons );
 
+	/** Points for an item, read from the FItemRegistry by the item's class id. 0 if the item can't be sunk. */
 	int32 GetResourceSinkPointsForItem( TSubclassOf< class UFGItemDescriptor > itemDescriptor );
 
 private:
@@ -162,10 +163,6 @@ private:
 	/** The timer handle that is used to trigger updates of the global points history of the resource sink subsystem */
 	FTimerHandle mCalculateHistoryTimer;
 
-	/** Cached points per itemdescriptor */
-	UPROPERTY( Transient )
-	TMap< TSubclassOf< class UFGItemDescriptor >, int32 > mResourceSinkPoints;
-	
 	/** Cached number of points we need to reach to unlock a new coupon */
 	TArray<int64> mRewardLevels;
 	
@@ -0,0 +1,163 @@
+// Copyright 2016-2020 Coffee Stain Studios. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter64.h"
+
+/** What a profile event measured. */
+enum class EFactoryTickProfileEvent : uint8
+{
+	/** A whole factory tick, Value is the fixed tick debt after the tick. */
+	FTPE_Tick,
+	/** One fixed tick substep, Index is the substep. */
+	FTPE_Substep,
+	/** A worker executing a schedule, Index is the worker. Used for occupancy. */
+	FTPE_Worker,
+	/** A single buildable, ObjectID is the buildable. */
+	FTPE_Buildable,
+	/** A conveyor bucket, ObjectID is the first conveyor in the bucket. */
+	FTPE_ConveyorBucket,
+	/** A conveyor attachment, ObjectID is the attachment. */
+	FTPE_ConveyorAttachment,
+	/** The serial conveyor group. */
+	FTPE_SerialConveyors
+};
+
+/**
+ * A single measurement in the factory tick profiler, kept small so the ring buffer can hold many ticks.
+ * Times are in cycles relative to the start of the tick the event was recorded in.
+ */
+struct FFactoryTickProfileEvent
+{
+	uint32 StartCycles;
+	uint32 DurationCycles;
+
+	/** UObject unique id, resolved to a name and class on export. */
+	uint32 ObjectID;
+
+	/** Event dependent value, see EFactoryTickProfileEvent. */
+	float Value;
+
+	/** Which tick this event belongs to, wraps. */
+	uint16 TickNumber;
+
+	/** Worker or substep index. */
+	uint8 Index;
+
+	EFactoryTickProfileEvent Type;
+};
+
+/**
+ * Sampling profiler for the factory tick.
+ * Events are written lock free from any worker to a fixed size ring buffer, older events are overwritten.
+ * Only every mSampleInterval:th tick is recorded to keep the overhead low.
+ * Export is done from the game thread outside of the factory tick, e.g. from a console command.
+ */
+class FACTORYGAME_API FFactoryTickProfiler
+{
+public:
+	/** Start recording, capacity is the number of events kept. */
+	void Enable( int32 capacity, int32 sampleInterval )
+	{
+		mEvents.SetNumZeroed( FMath::RoundUpToPowerOfTwo( FMath::Max( capacity, 1024 ) ) );
+		mWriteCounter.Reset();
+		mSampleInterval = FMath::Max( sampleInterval, 1 );
+		mTickCounter = 0;
+		mIsEnabled = true;
+	}
+
+	void Disable()
+	{
+		mIsEnabled = false;
+		mIsSampling = false;
+	}
+
+	FORCEINLINE bool IsEnabled() const { return mIsEnabled; }
+
+	/** @return true if the current tick is recorded. */
+	FORCEINLINE bool IsSampling() const { return mIsSampling; }
+
+	/** Call at the start of every factory tick, decides if the tick is sampled. */
+	FORCEINLINE void BeginTick()
+	{
+		mIsSampling = mIsEnabled && ( mTickCounter++ % mSampleInterval ) == 0;
+		mTickStartCycles = FPlatformTime::Cycles();
+	}
+
+	/** Call at the end of every factory tick. */
+	FORCEINLINE void EndTick( float fixedTickDebt )
+	{
+		if( mIsSampling )
+		{
+			Record( EFactoryTickProfileEvent::FTPE_Tick, mTickStartCycles, 0, 0, fixedTickDebt );
+		}
+		mIsSampling = false;
+	}
+
+	/** Record an event, thread safe. Ignored if not sampling. */
+	FORCEINLINE void Record( EFactoryTickProfileEvent type, uint32 startCycles, uint32 objectID, uint8 index, float value = 0.f )
+	{
+		if( !mIsSampling )
+		{
+			return;
+		}
+
+		const uint32 endCycles = FPlatformTime::Cycles();
+		const int32 slot = static_cast< int32 >( ( mWriteCounter.Increment() - 1 ) & ( mEvents.Num() - 1 ) );
+		FFactoryTickProfileEvent& event = mEvents[ slot ];
+		event.StartCycles = startCycles - mTickStartCycles;
+		event.DurationCycles = endCycles - startCycles;
+		event.ObjectID = objectID;
+		event.Value = value;
+		event.TickNumber = ( uint16 )( mTickCounter - 1 );
+		event.Index = index;
+		event.Type = type;
+	}
+
+	/** Get the recorded events, oldest first. Not thread safe, do not call during the factory tick. */
+	void GetEvents( TArray< FFactoryTickProfileEvent >& out_events ) const
+	{
+		out_events.Reset();
+		const int64 numWritten = mWriteCounter.GetValue();
+		const int32 numEvents = static_cast< int32 >( FMath::Min< int64 >( numWritten, mEvents.Num() ) );
+		out_events.Reserve( numEvents );
+		for( int64 i = numWritten - numEvents; i < numWritten; ++i )
+		{
+			out_events.Add( mEvents[ static_cast< int32 >( i & ( mEvents.Num() - 1 ) ) ] );
+		}
+	}
+
+	/**
+	 * Write the events as a chrome trace (chrome://tracing, json), each worker is a thread.
+	 * Buildables are named by their name and class.
+	 * @return true on success.
+	 */
+	bool ExportChromeTrace( const FString& filePath ) const;
+
+	/**
+	 * Write the events in the collapsed stack format used by flame graph tools, one line per stack with the total time in microseconds.
+	 * Stacks are Tick;Type;Class;Name.
+	 * @return true on success.
+	 */
+	bool ExportFlameGraph( const FString& filePath ) const;
+
+private:
+	/** The ring buffer, size is a power of two. */
+	TArray< FFactoryTickProfileEvent > mEvents;
+
+	/** Total number of events written, the write position in the ring buffer is this masked. 64 bit as a long session writes more than 2^31 events. */
+	FThreadSafeCounter64 mWriteCounter;
+
+	/** Record every n:th tick. */
+	int32 mSampleInterval = 1;
+
+	/** Number of factory ticks since enabled. */
+	uint32 mTickCounter = 0;
+
+	/** Cycles when the current tick started, event start times are relative to this. */
+	uint32 mTickStartCycles = 0;
+
+	bool mIsEnabled = false;
+	bool mIsSampling = false;
+};
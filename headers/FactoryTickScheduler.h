@@ -0,0 +1,209 @@
+// Copyright 2016-2020 Coffee Stain Studios. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Async/ParallelFor.h"
+#include "FactoryTickProfiler.h"
+
+/**
+ * Estimated cost of ticking a single unit of factory work (a buildable, a conveyor bucket etc.)
+ * Measured from previous factory ticks and smoothed so a single hitch does not reshuffle the whole schedule.
+ */
+struct FFactoryTickCost
+{
+	/** How much of a new sample is blended into the estimate [0,1] */
+	static constexpr float SMOOTHING = 0.2f;
+
+	/** Smoothed cost in cycles, 0 if never measured */
+	float EstimatedCycles = 0.f;
+
+	FORCEINLINE bool HasEstimate() const { return EstimatedCycles > 0.f; }
+
+	FORCEINLINE void AddSample( uint32 cycles )
+	{
+		const float sample = FMath::Max( static_cast< float >( cycles ), 1.f );
+		EstimatedCycles = HasEstimate() ? FMath::Lerp( EstimatedCycles, sample, SMOOTHING ) : sample;
+	}
+};
+
+/**
+ * Work stealing scheduler for the factory tick.
+ *
+ * Items are distributed on one queue per worker, heaviest first onto the least loaded queue, using the cost measured in previous ticks.
+ * A worker that empties its own queue continues by stealing from the other queues, so a badly estimated queue does not keep the other cores idle.
+ * The schedule is kept between ticks and only rebuilt when dirty, i.e. when items are added or removed, or when the estimates have had time to drift.
+ */
+template< typename ItemType >
+class TFactoryTickScheduler
+{
+public:
+	/** Retrieve the cost estimate for an item, must be unique per item as it is written to from the worker ticking it. */
+	typedef TFunctionRef< FFactoryTickCost&( ItemType ) > FGetCostFunc;
+
+	/** Tick a single item */
+	typedef TFunctionRef< void( ItemType ) > FTickFunc;
+
+	/** Get the object id an item is recorded with in the profiler */
+	typedef TFunctionRef< uint32( ItemType ) > FGetProfileIDFunc;
+
+	/** Flag that the items have changed and a new schedule is needed before the next execute. */
+	FORCEINLINE void MarkDirty() { mIsDirty = true; }
+
+	/** @return true if Schedule should be called before next Execute. */
+	FORCEINLINE bool NeedsSchedule( int32 numWorkers, int32 rescheduleInterval ) const
+	{
+		return mIsDirty || mQueues.Num() != numWorkers || ( rescheduleInterval > 0 && mExecutionsSinceSchedule >= rescheduleInterval );
+	}
+
+	/** Number of items in the current schedule. */
+	FORCEINLINE int32 Num() const { return mItems.Num(); }
+
+	/** Removes all items and queues. */
+	void Empty()
+	{
+		mItems.Empty();
+		mQueues.Empty();
+		mIsDirty = true;
+	}
+
+	/**
+	 * Distributes the items over numWorkers queues using the longest processing time first heuristic.
+	 * Items without a measurement are assumed to cost the average of the measured ones.
+	 */
+	void Schedule( const TArray< ItemType >& items, int32 numWorkers, FGetCostFunc getCost )
+	{
+		mItems = items;
+		mIsDirty = false;
+		mExecutionsSinceSchedule = 0;
+
+		numWorkers = FMath::Clamp( numWorkers, 1, FMath::Max( mItems.Num(), 1 ) );
+		mQueues.SetNum( numWorkers );
+		for( FWorkerQueue& queue : mQueues )
+		{
+			queue.Items.Reset();
+			queue.Items.Reserve( mItems.Num() / numWorkers + 1 );
+		}
+
+		TArray< float > costs;
+		costs.SetNumUninitialized( mItems.Num() );
+		float measuredSum = 0.f;
+		int32 numMeasured = 0;
+		for( int32 i = 0; i < mItems.Num(); ++i )
+		{
+			const FFactoryTickCost& cost = getCost( mItems[ i ] );
+			costs[ i ] = cost.EstimatedCycles;
+			if( cost.HasEstimate() )
+			{
+				measuredSum += cost.EstimatedCycles;
+				++numMeasured;
+			}
+		}
+
+		const float defaultCost = numMeasured > 0 ? measuredSum / numMeasured : 1.f;
+		TArray< int32 > order;
+		order.SetNumUninitialized( mItems.Num() );
+		for( int32 i = 0; i < mItems.Num(); ++i )
+		{
+			if( costs[ i ] <= 0.f )
+			{
+				costs[ i ] = defaultCost;
+			}
+			order[ i ] = i;
+		}
+		order.Sort( [ &costs ]( int32 a, int32 b ) { return costs[ a ] > costs[ b ]; } );
+
+		TArray< float > load;
+		load.SetNumZeroed( numWorkers );
+		for( int32 itemIdx : order )
+		{
+			int32 lightestIdx = 0;
+			for( int32 w = 1; w < numWorkers; ++w )
+			{
+				if( load[ w ] < load[ lightestIdx ] )
+				{
+					lightestIdx = w;
+				}
+			}
+			load[ lightestIdx ] += costs[ itemIdx ];
+			mQueues[ lightestIdx ].Items.Add( itemIdx );
+		}
+	}
+
+	/**
+	 * Ticks all scheduled items, each item exactly once.
+	 * Each worker first drains its own queue and then steals from the others, the measured time is fed back into the item's cost.
+	 */
+	void Execute( FTickFunc tickFunc, FGetCostFunc getCost, bool forceSingleThread = false )
+	{
+		Execute( tickFunc, getCost, nullptr, EFactoryTickProfileEvent::FTPE_Buildable, []( ItemType ) { return 0u; }, forceSingleThread );
+	}
+
+	/**
+	 * Same as Execute but records each item and each workers occupancy in the profiler if it is sampling this tick.
+	 * @param eventType - What to record the items as.
+	 */
+	void Execute( FTickFunc tickFunc, FGetCostFunc getCost, FFactoryTickProfiler* profiler, EFactoryTickProfileEvent eventType, FGetProfileIDFunc getProfileID, bool forceSingleThread = false )
+	{
+		++mExecutionsSinceSchedule;
+		if( mItems.Num() == 0 )
+		{
+			return;
+		}
+
+		for( FWorkerQueue& queue : mQueues )
+		{
+			queue.Head.Reset();
+		}
+
+		const bool isProfiling = profiler && profiler->IsSampling();
+		const int32 numQueues = mQueues.Num();
+		ParallelFor( numQueues, [ & ]( int32 workerIdx )
+		{
+			const uint32 workerStartCycles = FPlatformTime::Cycles();
+			// Start on our own queue, then walk the others and steal what is left.
+			for( int32 offset = 0; offset < numQueues; ++offset )
+			{
+				FWorkerQueue& queue = mQueues[ ( workerIdx + offset ) % numQueues ];
+				for( int32 slot = queue.Head.Increment() - 1; slot < queue.Items.Num(); slot = queue.Head.Increment() - 1 )
+				{
+					ItemType item = mItems[ queue.Items[ slot ] ];
+					const uint32 startCycles = FPlatformTime::Cycles();
+					tickFunc( item );
+					getCost( item ).AddSample( FPlatformTime::Cycles() - startCycles );
+					if( isProfiling )
+					{
+						profiler->Record( eventType, startCycles, getProfileID( item ), ( uint8 )workerIdx );
+					}
+				}
+			}
+
+			if( isProfiling )
+			{
+				profiler->Record( EFactoryTickProfileEvent::FTPE_Worker, workerStartCycles, 0, ( uint8 )workerIdx );
+			}
+		}, forceSingleThread );
+	}
+
+private:
+	/** Indices into mItems, claimed by incrementing Head. Padded to avoid false sharing between the workers' counters. */
+	struct FWorkerQueue
+	{
+		TArray< int32 > Items;
+		FThreadSafeCounter Head;
+		uint8 Padding[ PLATFORM_CACHE_LINE_SIZE ];
+	};
+
+	/** The items scheduled. */
+	TArray< ItemType > mItems;
+
+	/** One queue per worker. */
+	TArray< FWorkerQueue > mQueues;
+
+	/** If the items have changed since the last schedule. */
+	bool mIsDirty = true;
+
+	/** How many times we've executed this schedule, used to reschedule when the cost estimates have drifted. */
+	int32 mExecutionsSinceSchedule = 0;
+};
@@ -6,6 +6,12 @@
 #include "Styling/SlateBrush.h"
 #include "FGItemDescriptor.generated.h"
 
+/** Dense id for an item class, see FItemRegistry. */
+typedef uint16 FItemClassID;
+
+/** Id for null or unregistered item classes. */
+static constexpr FItemClassID INVALID_ITEM_CLASS_ID = MAX_uint16;
+
 /**
  * The form this item is in, i.e. does it require pipes or conveyors, can the player pick it up etc.
  */
@@ -382,4 +388,8 @@ protected:
 private:
 	friend class FItemDescriptorDetails;
 	friend class FFGItemDescriptorPropertyHandle;
+	friend class FItemRegistry;
+
+	/** Id in the FItemRegistry, only set on the CDO. Not saved or replicated, the registry assigns the same ids on server and clients. */
+	FItemClassID mItemClassID = INVALID_ITEM_CLASS_ID;
 };
@@ -0,0 +1,68 @@
+// Copyright 2016-2020 Coffee Stain Studios. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FGItemDescriptor.h"
+
+/** Descriptor values cached per item class so the hot paths don't need to look at the CDO. */
+struct FItemClassInfo
+{
+	TSubclassOf< UFGItemDescriptor > ItemClass;
+	int32 StackSize = 0;
+	EResourceForm Form = EResourceForm::RF_INVALID;
+	float EnergyValue = 0.f;
+	float RadioactiveDecay = 0.f;
+	bool CanBeDiscarded = false;
+	/** Points from the resource sink, set by the resource sink subsystem when it has read its data table. The subsystem keeps no copy of its own. */
+	int32 ResourceSinkPoints = 0;
+};
+
+/**
+ * Registry of all item descriptor classes with a dense id each.
+ * Built once at startup from all loaded UFGItemDescriptor subclasses, ids are assigned in name order so they are the same on server and clients.
+ * Build is called from UFGGameInstance::Init, before any world is loaded. Systems that index by id at load, e.g. AFGRecipeManager::RebuildRecipeIndex, call Build if !IsBuilt to be safe.
+ * The id is stored on the class default object so converting a class is a pointer read, no hashing.
+ * Convert to an id once at the edge of a system and then use the id to index flat arrays instead of hashing the class in a TMap.
+ *
+ * @note Ids are not persistent, never save them.
+ */
+class FACTORYGAME_API FItemRegistry
+{
+public:
+	/**
+	 * Register all item descriptor classes, blueprint generated ones included, and write the ids to their CDOs.
+	 * Called from UFGGameInstance::Init, the descriptors are loaded from the asset registry.
+	 */
+	static void Build();
+
+	/** @return true if Build has been called. */
+	static FORCEINLINE bool IsBuilt() { return Infos.Num() > 0; }
+
+	/** Number of registered classes, the ids are in range [0,Num). Use to size arrays indexed by id. */
+	static FORCEINLINE int32 Num() { return Infos.Num(); }
+
+	/** Get the id for a class, INVALID_ITEM_CLASS_ID if null or not registered. */
+	static FORCEINLINE FItemClassID GetID( TSubclassOf< UFGItemDescriptor > itemClass )
+	{
+		return itemClass ? itemClass->GetDefaultObject< UFGItemDescriptor >()->mItemClassID : INVALID_ITEM_CLASS_ID;
+	}
+
+	static FORCEINLINE bool IsValidID( FItemClassID id ) { return id < Infos.Num(); }
+
+	/** Get the cached values for an id. */
+	static FORCEINLINE const FItemClassInfo& GetInfo( FItemClassID id ) { return Infos[ id ]; }
+
+	static FORCEINLINE TSubclassOf< UFGItemDescriptor > GetItemClass( FItemClassID id ) { return Infos[ id ].ItemClass; }
+	static FORCEINLINE int32 GetStackSize( FItemClassID id ) { return Infos[ id ].StackSize; }
+	static FORCEINLINE EResourceForm GetForm( FItemClassID id ) { return Infos[ id ].Form; }
+	static FORCEINLINE float GetRadioactiveDecay( FItemClassID id ) { return Infos[ id ].RadioactiveDecay; }
+	static FORCEINLINE int32 GetResourceSinkPoints( FItemClassID id ) { return Infos[ id ].ResourceSinkPoints; }
+
+	/** Set the resource sink points, called by the resource sink subsystem. */
+	static FORCEINLINE void SetResourceSinkPoints( FItemClassID id, int32 points ) { Infos[ id ].ResourceSinkPoints = points; }
+
+private:
+	/** Cached values, the index is the id. */
+	static TArray< FItemClassInfo > Infos;
+};